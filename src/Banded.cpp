@@ -0,0 +1,487 @@
+#include "Banded.h"
+#include "Instrumentation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+/// <summary>
+/// Implementation of the band and block tridiagonal storages and of their
+/// factorizations.
+/// </summary>
+
+namespace als {
+
+	/**
+	* Number of sub-diagonals and super-diagonals holding elements larger
+	* than the tolerance.
+	* @param lower receives the lower bandwidth kl
+	* @param upper receives the upper bandwidth ku
+	*/
+	void detectBandwidth(const Matrix& A, int* lower, int* upper, double tolerance) {
+
+		*lower = 0;
+		*upper = 0;
+
+		for (int i = 0; i < A.rowCount(); i++) {
+
+			const double* r = A.row(i);
+
+			// Only the elements outside the current band can widen it
+			for (int j = 0; j < i - *lower; j++) {
+				if (std::abs(r[j]) > tolerance) {
+					*lower = i - j;
+					break;
+				}
+			}
+			for (int j = A.colCount() - 1; j > i + *upper; j--) {
+				if (std::abs(r[j]) > tolerance) {
+					*upper = j - i;
+					break;
+				}
+			}
+		}
+	}
+
+	/*** Band matrix ***/
+
+	BandMatrix::BandMatrix(int n, int kl, int ku)
+		: _n(n), _kl(kl), _ku(ku), _ab(static_cast<size_t>(n) * (kl + ku + 1), 0.0) {
+
+		ALS_COUNT_BYTES(sizeof(double) * _ab.size());
+	}
+
+	/**
+	* Band storage of a square matrix, with its detected bandwidths.
+	* @param tolerance elements at most this large outside the band are dropped
+	*/
+	BandMatrix BandMatrix::fromMatrix(const Matrix& A, double tolerance) {
+
+		if (!A.isSquare()) {
+			std::cerr << "FATAL ERROR: only square matrices have a band storage.\n";
+			std::exit(-1);
+		}
+
+		int kl, ku;
+		detectBandwidth(A, &kl, &ku, tolerance);
+
+		BandMatrix band(A.rowCount(), kl, ku);
+
+		for (int i = 0; i < A.rowCount(); i++) {
+			for (int j = std::max(0, i - kl); j <= std::min(A.rowCount() - 1, i + ku); j++) {
+				band.set(i, j, A(i, j));
+			}
+		}
+
+		return band;
+	}
+
+	double BandMatrix::get(int i, int j) const {
+		return inBand(i, j) ? _ab[_ku + i - j + j * leadingDimension()] : 0;
+	}
+
+	void BandMatrix::set(int i, int j, double value) {
+
+		if (!inBand(i, j)) {
+			std::cerr << "FATAL ERROR: the element (" << i << ", " << j << ") is outside of the band.\n";
+			std::exit(-1);
+		}
+
+		_ab[_ku + i - j + j * leadingDimension()] = value;
+	}
+
+	Matrix BandMatrix::toMatrix() const {
+
+		Matrix A = Matrix::Null(_n);
+
+		for (int j = 0; j < _n; j++) {
+			for (int i = std::max(0, j - _ku); i <= std::min(_n - 1, j + _kl); i++) {
+				A(i, j) = _ab[_ku + i - j + j * leadingDimension()];
+			}
+		}
+
+		return A;
+	}
+
+	/**
+	* Product with every column of x, in O(n * (kl + ku + 1)) per column.
+	* @param x n x k
+	*/
+	Matrix BandMatrix::multiply(const Matrix x) const {
+
+		const int k = x.colCount();
+		const int ld = leadingDimension();
+
+		Matrix y(_n, k);
+		std::fill_n(y.data(), _n * k, 0.0);
+
+		ALS_COUNT_FLOPS(2ull * _n * ld * k);
+
+		// Column by column of the band: y(i) += A(i, j) * x(j)
+		for (int j = 0; j < _n; j++) {
+			const double* column = _ab.data() + j * ld + _ku - j;
+			const double* xj = x.row(j);
+			for (int i = std::max(0, j - _ku); i <= std::min(_n - 1, j + _kl); i++) {
+				const double a = column[i];
+				double* yi = y.row(i);
+				for (int c = 0; c < k; c++) yi[c] += a * xj[c];
+			}
+		}
+
+		return y;
+	}
+
+	/*** Band LU ***/
+
+	/**
+	* Factor the band matrix (LAPACK dgbtf2). A zero pivot leaves its
+	* column uneliminated and marks the factorization singular.
+	*/
+	BandLUDecomposition::BandLUDecomposition(const BandMatrix& A)
+		: _n(A.size()), _kl(A.lowerBandwidth()), _ku(A.upperBandwidth()), _pivots(A.size()), _singular(false) {
+
+		ALS_PROFILE_SCOPE("BandLUDecomposition");
+
+		const int n = _n, kl = _kl, ku = _ku;
+		const int kv = kl + ku;
+		const int ld = 2 * kl + ku + 1;
+
+		// The band goes below kl extra rows receiving the fill-in
+		_ab.assign(static_cast<size_t>(n) * ld, 0.0);
+		for (int j = 0; j < n; j++) {
+			std::copy_n(A.band() + j * A.leadingDimension(), A.leadingDimension(), _ab.data() + j * ld + kl);
+		}
+
+		auto at = [&](int i, int j) -> double& { return _ab[kv + i - j + j * ld]; };
+
+		// Last column reached by the rows swapped so far
+		int ju = 0;
+
+		for (int j = 0; j < n; j++) {
+
+			const int km = std::min(kl, n - 1 - j);
+
+			int jp = 0;
+			for (int t = 1; t <= km; t++) {
+				if (std::abs(at(j + t, j)) > std::abs(at(j + jp, j))) jp = t;
+			}
+
+			_pivots[j] = j + jp;
+
+			const double pivot = at(j + jp, j);
+			if (pivot == 0) {
+				_singular = true;
+				continue;
+			}
+
+			ju = std::max(ju, std::min(j + ku + jp, n - 1));
+
+			if (jp != 0) {
+				for (int c = j; c <= ju; c++) std::swap(at(j, c), at(j + jp, c));
+				ALS_COUNT_PIVOT();
+			}
+
+			const double inverse = 1 / at(j, j);
+			for (int t = 1; t <= km; t++) at(j + t, j) *= inverse;
+
+			ALS_COUNT_FLOPS(2ull * km * (ju - j));
+
+			for (int c = j + 1; c <= ju; c++) {
+				const double u = at(j, c);
+				if (u == 0) continue;
+				for (int t = 1; t <= km; t++) at(j + t, c) -= at(j + t, j) * u;
+			}
+		}
+	}
+
+	/**
+	* Determinant as mantissa * 2^exponent, renormalized after every pivot.
+	*/
+	double BandLUDecomposition::scaledDeterminant(long long* exponent) const {
+
+		double mantissa = 1;
+		*exponent = 0;
+
+		for (int j = 0; j < _n; j++) {
+
+			if (_pivots[j] != j) mantissa = -mantissa;
+
+			int e;
+			mantissa = std::frexp(mantissa * pivot(j), &e);
+			*exponent += e;
+
+			if (mantissa == 0) {
+				*exponent = 0;
+				break;
+			}
+		}
+
+		return mantissa;
+	}
+
+	double BandLUDecomposition::determinant() const {
+
+		long long exponent;
+		double mantissa = scaledDeterminant(&exponent);
+
+		if (exponent > std::numeric_limits<int>::max()) return mantissa * std::numeric_limits<double>::infinity();
+		if (exponent < std::numeric_limits<int>::min()) return mantissa * 0.0;
+
+		return std::ldexp(mantissa, static_cast<int>(exponent));
+	}
+
+	/**
+	* Solve A * x = b for every column of b (LAPACK dgbtrs).
+	* @param b right hand sides (n x k)
+	*/
+	Matrix BandLUDecomposition::solve(const Matrix b) const {
+
+		const int n = _n, k = b.colCount();
+		const int kv = _kl + _ku;
+		const int ld = 2 * _kl + _ku + 1;
+
+		Matrix x = b;
+
+		ALS_COUNT_FLOPS(2ull * n * (2 * _kl + _ku + 1) * k);
+
+		// L * y = P * b
+		for (int j = 0; j < n; j++) {
+
+			if (_pivots[j] != j) x.swapEquations(j, _pivots[j]);
+
+			const double* xj = x.row(j);
+			const double* l = _ab.data() + kv + j * ld;
+			for (int t = 1; t <= std::min(_kl, n - 1 - j); t++) {
+				double* xt = x.row(j + t);
+				for (int c = 0; c < k; c++) xt[c] -= l[t] * xj[c];
+			}
+		}
+
+		// U * x = y, U has kl + ku super-diagonals
+		for (int j = n - 1; j >= 0; j--) {
+
+			double* xj = x.row(j);
+			const double* u = _ab.data() + kv + j * ld;
+			for (int c = 0; c < k; c++) xj[c] /= u[0];
+
+			for (int i = std::max(0, j - kv); i < j; i++) {
+				const double a = u[i - j];
+				double* xi = x.row(i);
+				for (int c = 0; c < k; c++) xi[c] -= a * xj[c];
+			}
+		}
+
+		return x;
+	}
+
+	/*** Block tridiagonal ***/
+
+	BlockTridiagonal::BlockTridiagonal(int blockCount, int blockSize) : _blockSize(blockSize) {
+
+		for (int i = 0; i < blockCount; i++) {
+			_diagonal.push_back(Matrix::Null(blockSize));
+			if (i + 1 < blockCount) {
+				_lower.push_back(Matrix::Null(blockSize));
+				_upper.push_back(Matrix::Null(blockSize));
+			}
+		}
+	}
+
+	/**
+	* Copy the three block diagonals of a square matrix.
+	* @return false if the size is not a multiple of the block size or if an
+	* element outside of the block diagonals is not zero
+	*/
+	bool BlockTridiagonal::fromMatrix(const Matrix& A, int blockSize, BlockTridiagonal* result) {
+
+		const int n = A.rowCount();
+
+		if (!A.isSquare() || blockSize <= 0 || n % blockSize != 0) return false;
+
+		const int count = n / blockSize;
+		*result = BlockTridiagonal(count, blockSize);
+
+		for (int i = 0; i < n; i++) {
+
+			const int bi = i / blockSize;
+			const double* r = A.row(i);
+
+			for (int j = 0; j < n; j++) {
+
+				const int bj = j / blockSize;
+				const double a = r[j];
+
+				if (bj == bi) result->_diagonal[bi](i % blockSize, j % blockSize) = a;
+				else if (bj == bi - 1) result->_lower[bj](i % blockSize, j % blockSize) = a;
+				else if (bj == bi + 1) result->_upper[bi](i % blockSize, j % blockSize) = a;
+				else if (a != 0) return false;
+			}
+		}
+
+		return true;
+	}
+
+	Matrix BlockTridiagonal::toMatrix() const {
+
+		const int b = _blockSize;
+		Matrix A = Matrix::Null(size());
+
+		auto place = [&](const Matrix& block, int bi, int bj) {
+			for (int r = 0; r < b; r++) std::copy_n(block.row(r), b, A.row(bi * b + r) + bj * b);
+		};
+
+		for (int i = 0; i < blockCount(); i++) {
+			place(_diagonal[i], i, i);
+			if (i + 1 < blockCount()) {
+				place(_lower[i], i + 1, i);
+				place(_upper[i], i, i + 1);
+			}
+		}
+
+		return A;
+	}
+
+	namespace {
+
+		/**
+		* Rows [block * b, (block + 1) * b) of x.
+		*/
+		Matrix blockRows(const Matrix& x, int block, int b) {
+			Matrix rows(b, x.colCount());
+			std::copy_n(x.row(block * b), b * x.colCount(), rows.data());
+			return rows;
+		}
+
+		/**
+		* target(block rows) += sign * product
+		*/
+		void accumulate(Matrix& target, int block, const Matrix& product, double sign) {
+			double* t = target.row(block * product.rowCount());
+			const double* p = product.data();
+			for (int a = 0; a < product.rowCount() * product.colCount(); a++) t[a] += sign * p[a];
+		}
+	}
+
+	/**
+	* Product with every column of x.
+	* @param x n x k
+	*/
+	Matrix BlockTridiagonal::multiply(const Matrix x) const {
+
+		const int b = _blockSize;
+		const int count = blockCount();
+
+		Matrix y(size(), x.colCount());
+		std::fill_n(y.data(), size() * x.colCount(), 0.0);
+
+		for (int i = 0; i < count; i++) {
+			accumulate(y, i, _diagonal[i] * blockRows(x, i, b), 1);
+			if (i > 0) accumulate(y, i, _lower[i - 1] * blockRows(x, i - 1, b), 1);
+			if (i + 1 < count) accumulate(y, i, _upper[i] * blockRows(x, i + 1, b), 1);
+		}
+
+		return y;
+	}
+
+	/*** Block tridiagonal LU ***/
+
+	BlockTridiagonalLU::BlockTridiagonalLU(const BlockTridiagonal& A) {
+
+		ALS_PROFILE_SCOPE("BlockTridiagonalLU");
+
+		const int count = A.blockCount();
+
+		_schur.reserve(count);
+
+		for (int i = 0; i < count; i++) {
+
+			Matrix S = A.diagonal(i);
+
+			if (i > 0) {
+				_lower.push_back(A.lower(i - 1));
+				accumulate(S, 0, A.lower(i - 1) * _G[i - 1], -1);
+			}
+
+			_schur.emplace_back(S);
+
+			// G(i) = S(i)^-1 * U(i)
+			if (i + 1 < count) _G.push_back(_schur[i].solve(A.upper(i)));
+		}
+	}
+
+	bool BlockTridiagonalLU::isSingular() const {
+		return std::any_of(_schur.begin(), _schur.end(), [](const LUDecomposition& lu) { return lu.isSingular(); });
+	}
+
+	/**
+	* Product of the determinants of the Schur complements.
+	*/
+	double BlockTridiagonalLU::scaledDeterminant(long long* exponent) const {
+
+		double mantissa = 1;
+		*exponent = 0;
+
+		for (const LUDecomposition& lu : _schur) {
+
+			long long e;
+			int renormalized;
+			mantissa = std::frexp(mantissa * lu.scaledDeterminant(&e), &renormalized);
+			*exponent += e + renormalized;
+
+			if (mantissa == 0) {
+				*exponent = 0;
+				break;
+			}
+		}
+
+		return mantissa;
+	}
+
+	double BlockTridiagonalLU::determinant() const {
+
+		long long exponent;
+		double mantissa = scaledDeterminant(&exponent);
+
+		if (exponent > std::numeric_limits<int>::max()) return mantissa * std::numeric_limits<double>::infinity();
+		if (exponent < std::numeric_limits<int>::min()) return mantissa * 0.0;
+
+		return std::ldexp(mantissa, static_cast<int>(exponent));
+	}
+
+	/**
+	* Solve A * x = b for every column of b by block forward and back
+	* substitution.
+	* @param b right hand sides (n x k)
+	*/
+	Matrix BlockTridiagonalLU::solve(const Matrix b) const {
+
+		const int count = static_cast<int>(_schur.size());
+
+		if (count == 0) return Matrix(0, b.colCount());
+
+		const int size = _schur.front().size();
+
+		if (b.rowCount() != count * size) {
+			std::cerr << "FATAL ERROR: the right hand sides don't have as many rows as the system.\n";
+			std::exit(-1);
+		}
+
+		Matrix x(b.rowCount(), b.colCount());
+
+		// y(i) = S(i)^-1 * (b(i) - L(i - 1) * y(i - 1))
+		for (int i = 0; i < count; i++) {
+			Matrix rhs = blockRows(b, i, size);
+			if (i > 0) accumulate(rhs, 0, _lower[i - 1] * blockRows(x, i - 1, size), -1);
+			Matrix y = _schur[i].solve(rhs);
+			std::copy_n(y.data(), y.rowCount() * y.colCount(), x.row(i * size));
+		}
+
+		// x(i) = y(i) - G(i) * x(i + 1)
+		for (int i = count - 2; i >= 0; i--) {
+			accumulate(x, i, _G[i] * blockRows(x, i + 1, size), -1);
+		}
+
+		return x;
+	}
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include "Matrix.h"
+#include "LU.h"
+
+#include <vector>
+
+namespace als {
+
+	void detectBandwidth(const Matrix& A, int* lower, int* upper, double tolerance = 0);
+
+	/**
+	* Square matrix with kl sub-diagonals and ku super-diagonals, in the
+	* LAPACK band storage: column j holds A(j - ku : j + kl, j), so that
+	* A(i, j) is at ab[ku + i - j + j * (kl + ku + 1)]. O(n * (kl + ku))
+	* memory instead of O(n^2).
+	*/
+	class BandMatrix {
+
+		int _n, _kl, _ku;
+		std::vector<double> _ab;
+
+	public:
+
+		BandMatrix(int n, int kl, int ku);
+		static BandMatrix fromMatrix(const Matrix& A, double tolerance = 0);
+
+		int size() const { return _n; }
+		int lowerBandwidth() const { return _kl; }
+		int upperBandwidth() const { return _ku; }
+		int leadingDimension() const { return _kl + _ku + 1; }
+		const double* band() const { return _ab.data(); }
+
+		bool inBand(int i, int j) const { return i - j <= _kl && j - i <= _ku; }
+		double get(int i, int j) const;
+		void set(int i, int j, double value);
+
+		Matrix toMatrix() const;
+		Matrix multiply(const Matrix x) const;
+	};
+
+	/**
+	* Partial pivoting LU factorization P * A = L * U of a band matrix, in
+	* O(n * kl * (kl + ku)). The row interchanges widen U to kl + ku
+	* super-diagonals, kept in kl extra rows of the band storage.
+	*/
+	class BandLUDecomposition {
+
+		int _n, _kl, _ku;
+		std::vector<double> _ab;
+		std::vector<int> _pivots;
+		bool _singular;
+
+	public:
+
+		BandLUDecomposition(const BandMatrix& A);
+
+		int size() const { return _n; }
+		const std::vector<int>& pivots() const { return _pivots; }
+		bool isSingular() const { return _singular; }
+
+		double pivot(int j) const { return _ab[_kl + _ku + j * (2 * _kl + _ku + 1)]; }
+		double determinant() const;
+		double scaledDeterminant(long long* exponent) const;
+
+		Matrix solve(const Matrix b) const;
+	};
+
+	/**
+	* Block tridiagonal matrix of square blocks of equal size:
+	* block row i holds lower(i - 1), diagonal(i) and upper(i).
+	*/
+	class BlockTridiagonal {
+
+		int _blockSize;
+		std::vector<Matrix> _lower, _diagonal, _upper;
+
+	public:
+
+		BlockTridiagonal(int blockCount, int blockSize);
+		static bool fromMatrix(const Matrix& A, int blockSize, BlockTridiagonal* result);
+
+		int blockCount() const { return static_cast<int>(_diagonal.size()); }
+		int blockSize() const { return _blockSize; }
+		int size() const { return blockCount() * _blockSize; }
+
+		Matrix& lower(int i) { return _lower[i]; }
+		Matrix& diagonal(int i) { return _diagonal[i]; }
+		Matrix& upper(int i) { return _upper[i]; }
+		const Matrix& lower(int i) const { return _lower[i]; }
+		const Matrix& diagonal(int i) const { return _diagonal[i]; }
+		const Matrix& upper(int i) const { return _upper[i]; }
+
+		Matrix toMatrix() const;
+		Matrix multiply(const Matrix x) const;
+	};
+
+	/**
+	* Block LU factorization (block Thomas algorithm) in O(n * b^2):
+	* S(0) = D(0), S(i) = D(i) - L(i - 1) * S(i - 1)^-1 * U(i - 1).
+	* The Schur complements are factored with partial pivoting, but no
+	* pivoting happens between blocks, which suits block diagonally
+	* dominant matrices.
+	*/
+	class BlockTridiagonalLU {
+
+		std::vector<Matrix> _lower;
+		std::vector<LUDecomposition> _schur;
+		std::vector<Matrix> _G;
+
+	public:
+
+		BlockTridiagonalLU(const BlockTridiagonal& A);
+
+		bool isSingular() const;
+		double determinant() const;
+		double scaledDeterminant(long long* exponent) const;
+
+		Matrix solve(const Matrix b) const;
+	};
+}
@@ -0,0 +1,163 @@
+#include "Benchmark.h"
+#include "Kernels.h"
+#include "LU.h"
+#include "Matrix.h"
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <random>
+
+/// <summary>
+/// Timings of the alternative algorithms offered for the same problem,
+/// run with the --bench command line option.
+/// </summary>
+
+namespace als {
+
+	namespace {
+
+		Matrix randomMatrix(int m, int n, std::mt19937& generator) {
+
+			std::uniform_real_distribution<double> distribution(-1, 1);
+			Matrix A(m, n);
+
+			for (int a = 0; a < m * n; a++) A(a) = distribution(generator);
+
+			return A;
+		}
+
+		/**
+		* Best wall time in milliseconds of a few runs.
+		*/
+		template <typename F>
+		double timeMs(F&& f, int runs = 3) {
+
+			double best = 1e300;
+
+			for (int r = 0; r < runs; r++) {
+				auto start = std::chrono::steady_clock::now();
+				f();
+				std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+				best = std::min(best, elapsed.count());
+			}
+
+			return best;
+		}
+
+		/**
+		* Relative distance between two solutions in the max norm.
+		*/
+		double relativeError(const Matrix& x, const Matrix& reference) {
+
+			double diff = 0, norm = 0;
+
+			for (int a = 0; a < x.rowCount() * x.colCount(); a++) {
+				diff = std::max(diff, std::abs(x(a) - reference(a)));
+				norm = std::max(norm, std::abs(reference(a)));
+			}
+
+			return norm > 0 ? diff / norm : diff;
+		}
+
+		/**
+		* Least squares through QR against the normal equations A^T A x = A^T b.
+		* Both are timed on random problems, then compared on a polynomial fit
+		* whose Vandermonde matrix is ill-conditioned.
+		*/
+		void leastSquaresBenchmark(std::ostream& out, std::mt19937& generator) {
+
+			out << "--- Least squares: QR vs normal equations ---\n"
+				<< std::setw(12) << "size" << std::setw(12) << "QR ms" << std::setw(14) << "normal ms" << "\n";
+
+			for (auto [m, n] : { std::pair{ 500, 50 }, std::pair{ 2000, 200 }, std::pair{ 4000, 400 } }) {
+
+				Matrix A = randomMatrix(m, n, generator);
+				Matrix b = randomMatrix(m, 1, generator);
+
+				double qr = timeMs([&]() { Matrix::leastSquares(A, b); });
+				double normal = timeMs([&]() {
+					Matrix At = A.transpose();
+					LUDecomposition(At * A).solve(At * b);
+				});
+
+				out << std::setw(12) << (std::to_string(m) + "x" + std::to_string(n))
+					<< std::fixed << std::setprecision(2)
+					<< std::setw(12) << qr << std::setw(14) << normal << "\n" << std::defaultfloat;
+			}
+
+			// Degree 11 fit of a known polynomial on [0, 1]
+			const int m = 200, n = 12;
+			Matrix V(m, n), coefficients(n, 1), y(m, 1);
+
+			for (int i = 0; i < n; i++) coefficients(i) = 1;
+
+			for (int j = 0; j < m; j++) {
+				double t = double(j) / (m - 1), power = 1, value = 0;
+				for (int i = 0; i < n; i++) {
+					V(j, i) = power;
+					value += power;
+					power *= t;
+				}
+				y(j) = value;
+			}
+
+			Matrix Vt = V.transpose();
+
+			out << "Vandermonde " << m << "x" << n << " relative error: QR "
+				<< relativeError(Matrix::leastSquares(V, y), coefficients)
+				<< ", normal equations "
+				<< relativeError(LUDecomposition(Vt * V).solve(Vt * y), coefficients) << "\n\n";
+		}
+
+		/**
+		* Blocked product against Strassen-Winograd for several crossovers,
+		* on square sizes and on odd sizes that need peeling at every level.
+		*/
+		void productBenchmark(std::ostream& out, std::mt19937& generator) {
+
+			const int crossovers[] = { 64, 128, 256, 512 };
+
+			out << "--- Matrix product: blocked vs Strassen-Winograd ---\n"
+				<< std::setw(12) << "size" << std::setw(12) << "blocked ms";
+			for (int crossover : crossovers) out << std::setw(10) << ("c=" + std::to_string(crossover));
+			out << std::setw(14) << "rel. error" << "\n";
+
+			for (int n : { 256, 512, 768, 1023, 1024, 1536, 2048 }) {
+
+				Matrix A = randomMatrix(n, n, generator);
+				Matrix B = randomMatrix(n, n, generator);
+				Matrix C(n, n);
+
+				double blocked = timeMs([&]() { C = Matrix::product(A, B, productAlgorithm::CLASSIC); }, 1);
+				Matrix reference = C;
+
+				out << std::setw(12) << n << std::fixed << std::setprecision(1) << std::setw(12) << blocked;
+
+				for (int crossover : crossovers) {
+					C = Matrix(n, n);
+					double strassen = timeMs([&]() {
+						kernels::strassen(n, n, n, A.data(), n, B.data(), n, C.data(), n, crossover);
+					}, 1);
+					out << std::setw(10) << strassen;
+				}
+
+				out << std::defaultfloat << std::setprecision(3) << std::setw(14)
+					<< relativeError(Matrix::product(A, B, productAlgorithm::STRASSEN), reference) << "\n";
+			}
+
+			out << "AUTO switches to Strassen-Winograd from " << kernels::strassenCrossover << "\n\n";
+		}
+	}
+
+	/**
+	* Run every benchmark and report to the stream.
+	*/
+	void runBenchmarks(std::ostream& out) {
+
+		std::mt19937 generator(42);
+
+		leastSquaresBenchmark(out, generator);
+		productBenchmark(out, generator);
+	}
+}
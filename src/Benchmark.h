@@ -0,0 +1,7 @@
+#pragma once
+#include <iosfwd>
+
+namespace als {
+
+	void runBenchmarks(std::ostream& out);
+}
@@ -0,0 +1,304 @@
+#include "Cache.h"
+#include "Instrumentation.h"
+
+#include <bit>
+#include <cstring>
+
+/// <summary>
+/// Implementation of the content hash and of the result cache.
+/// </summary>
+
+namespace als {
+
+	namespace {
+
+		constexpr uint64_t prime1 = 0x9E3779B185EBCA87ull;
+		constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4Full;
+		constexpr uint64_t prime3 = 0x165667B19E3779F9ull;
+		constexpr uint64_t prime4 = 0x85EBCA77C2B2AE63ull;
+		constexpr uint64_t prime5 = 0x27D4EB2F165667C5ull;
+
+		inline uint64_t round(uint64_t acc, uint64_t input) {
+			acc += input * prime2;
+			acc = std::rotl(acc, 31);
+			return acc * prime1;
+		}
+
+		inline uint64_t mergeRound(uint64_t acc, uint64_t lane) {
+			acc ^= round(0, lane);
+			return acc * prime1 + prime4;
+		}
+
+		inline uint64_t load(const double* p) {
+			uint64_t bits;
+			std::memcpy(&bits, p, sizeof(bits));
+			return bits;
+		}
+
+		size_t matrixBytes(const Matrix& A) {
+			return sizeof(Matrix) + sizeof(double) * A.rowCount() * A.colCount();
+		}
+
+		bool sameContent(const Matrix& A, const Matrix& B) {
+			return A.rowCount() == B.rowCount() && A.colCount() == B.colCount()
+				&& std::memcmp(A.data(), B.data(), sizeof(double) * A.rowCount() * A.colCount()) == 0;
+		}
+	}
+
+	/**
+	* 64 bit hash of the shape and of the bit patterns of the elements, after
+	* xxHash64. The four lanes are independent so their multiplications
+	* overlap in the pipeline.
+	* @param A matrix to hash
+	*/
+	uint64_t contentHash(const Matrix& A) {
+
+		const size_t count = static_cast<size_t>(A.rowCount()) * A.colCount();
+		const double* p = A.data();
+		const double* end = p + count;
+
+		uint64_t seed = (static_cast<uint64_t>(A.rowCount()) << 32) ^ static_cast<uint32_t>(A.colCount());
+		uint64_t h;
+
+		if (count >= 4) {
+
+			uint64_t v1 = seed + prime1 + prime2;
+			uint64_t v2 = seed + prime2;
+			uint64_t v3 = seed;
+			uint64_t v4 = seed - prime1;
+
+			for (; p + 4 <= end; p += 4) {
+				v1 = round(v1, load(p));
+				v2 = round(v2, load(p + 1));
+				v3 = round(v3, load(p + 2));
+				v4 = round(v4, load(p + 3));
+			}
+
+			h = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+			h = mergeRound(h, v1);
+			h = mergeRound(h, v2);
+			h = mergeRound(h, v3);
+			h = mergeRound(h, v4);
+		}
+		else {
+			h = seed + prime5;
+		}
+
+		h += count * sizeof(double);
+
+		for (; p < end; p++) {
+			h ^= round(0, load(p));
+			h = std::rotl(h, 27) * prime1 + prime4;
+		}
+
+		h ^= h >> 33;
+		h *= prime2;
+		h ^= h >> 29;
+		h *= prime3;
+		h ^= h >> 32;
+
+		return h;
+	}
+
+	/**
+	* Cache shared by the whole program, disabled until given a capacity.
+	*/
+	MatrixCache& MatrixCache::global() {
+		static MatrixCache cache;
+		return cache;
+	}
+
+	/**
+	* Change the size limit, evicting the least recently used entries
+	* that no longer fit.
+	* @param capacityBytes limit in bytes, 0 to disable the cache
+	*/
+	void MatrixCache::setCapacity(size_t capacityBytes) {
+
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		_capacity = capacityBytes;
+		evict();
+	}
+
+	size_t MatrixCache::capacity() const {
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _capacity;
+	}
+
+	/**
+	* Drop every entry. The statistics are kept.
+	*/
+	void MatrixCache::clear() {
+
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		_index.clear();
+		_entries.clear();
+		_stats.bytes = 0;
+		_stats.entries = 0;
+	}
+
+	MatrixCache::Statistics MatrixCache::statistics() const {
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _stats;
+	}
+
+	/**
+	* Find the result of an operation and mark it as the most recently used.
+	* A hash match whose key differs from A counts as a miss.
+	*/
+	bool MatrixCache::lookup(operation op, uint64_t hash, const Matrix& A, Value* value) {
+
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		auto found = _index.find({ static_cast<int>(op), hash });
+
+		if (found == _index.end() || !sameContent(found->second->key, A)) {
+			_stats.misses++;
+			return false;
+		}
+
+		_entries.splice(_entries.begin(), _entries, found->second);
+		*value = found->second->value;
+		_stats.hits++;
+
+		return true;
+	}
+
+	/**
+	* Insert a result as the most recently used, replacing a colliding entry.
+	* Results larger than the whole capacity are not kept.
+	*/
+	void MatrixCache::store(operation op, uint64_t hash, const Matrix& A, Value value, size_t valueBytes) {
+
+		const size_t bytes = sizeof(Entry) + matrixBytes(A) + valueBytes;
+
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		if (bytes > _capacity) return;
+
+		std::pair<int, uint64_t> key = { static_cast<int>(op), hash };
+		auto found = _index.find(key);
+
+		if (found != _index.end()) {
+			_stats.bytes -= found->second->bytes;
+			_stats.entries--;
+			_entries.erase(found->second);
+			_index.erase(found);
+		}
+
+		_entries.push_front({ op, hash, A, std::move(value), bytes });
+		_index[key] = _entries.begin();
+		_stats.bytes += bytes;
+		_stats.entries++;
+
+		evict();
+	}
+
+	/**
+	* Remove least recently used entries until the cache fits its capacity.
+	* The caller holds the lock.
+	*/
+	void MatrixCache::evict() {
+
+		while (_stats.bytes > _capacity && !_entries.empty()) {
+
+			Entry& last = _entries.back();
+
+			_index.erase({ static_cast<int>(last.op), last.hash });
+			_stats.bytes -= last.bytes;
+			_stats.entries--;
+			_stats.evictions++;
+			_entries.pop_back();
+		}
+	}
+
+	/**
+	* Cached Matrix::determinant.
+	*/
+	double MatrixCache::determinant(const Matrix A) {
+
+		if (capacity() == 0) return Matrix::determinant(A);
+
+		ALS_PROFILE_SCOPE("MatrixCache::determinant");
+
+		uint64_t hash = contentHash(A);
+		Value value;
+
+		if (lookup(operation::DETERMINANT, hash, A, &value)) return std::get<double>(value);
+
+		double det = Matrix::determinant(A);
+		store(operation::DETERMINANT, hash, A, det, sizeof(double));
+
+		return det;
+	}
+
+	/**
+	* Cached Matrix::invert. The returned inverse shares its storage with the
+	* cache until it is written to, which leaves the cached one unchanged.
+	*/
+	InverseResult MatrixCache::invert(const Matrix A) {
+
+		if (capacity() == 0) return Matrix::invert(A);
+
+		ALS_PROFILE_SCOPE("MatrixCache::invert");
+
+		uint64_t hash = contentHash(A);
+		Value value;
+
+		if (lookup(operation::INVERSE, hash, A, &value)) return std::get<InverseResult>(value);
+
+		InverseResult result = Matrix::invert(A);
+		store(operation::INVERSE, hash, A, result, matrixBytes(result.inverse));
+
+		return result;
+	}
+
+	/**
+	* Cached Matrix::adjugate. The returned matrix shares its storage with the
+	* cache until it is written to, which leaves the cached one unchanged.
+	*/
+	Matrix MatrixCache::adjugate(const Matrix A) {
+
+		if (capacity() == 0) return Matrix::adjugate(A);
+
+		ALS_PROFILE_SCOPE("MatrixCache::adjugate");
+
+		uint64_t hash = contentHash(A);
+		Value value;
+
+		if (lookup(operation::ADJUGATE, hash, A, &value)) return std::get<Matrix>(value);
+
+		Matrix adj = Matrix::adjugate(A);
+		store(operation::ADJUGATE, hash, A, adj, matrixBytes(adj));
+
+		return adj;
+	}
+
+	/**
+	* Cached LU factorization with partial pivoting. The factorization is
+	* immutable, so it is shared with the cache instead of copied.
+	*/
+	std::shared_ptr<const LUDecomposition> MatrixCache::lu(const Matrix A) {
+
+		if (capacity() == 0) return std::make_shared<const LUDecomposition>(A);
+
+		ALS_PROFILE_SCOPE("MatrixCache::lu");
+
+		uint64_t hash = contentHash(A);
+		Value value;
+
+		if (lookup(operation::LU, hash, A, &value)) {
+			return std::get<std::shared_ptr<const LUDecomposition>>(value);
+		}
+
+		auto factors = std::make_shared<const LUDecomposition>(A);
+		store(operation::LU, hash, A, factors,
+			sizeof(LUDecomposition) + matrixBytes(factors->packed()) + 2 * sizeof(int) * A.rowCount());
+
+		return factors;
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include "Matrix.h"
+#include "LU.h"
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <variant>
+
+namespace als {
+
+	uint64_t contentHash(const Matrix& A);
+
+	/**
+	* LRU cache of the expensive results computed from a matrix, keyed by a
+	* hash of its shape and content. A hit costs one pass over the matrix to
+	* hash it and one to check that it really is the same matrix.
+	* Safe to share between threads. A capacity of 0 bytes disables it.
+	*/
+	class MatrixCache {
+
+	public:
+
+		enum class operation {
+			DETERMINANT,
+			INVERSE,
+			ADJUGATE,
+			LU,
+		};
+
+		struct Statistics {
+			uint64_t hits = 0;
+			uint64_t misses = 0;
+			uint64_t evictions = 0;
+			size_t bytes = 0;
+			size_t entries = 0;
+		};
+
+	private:
+
+		using Value = std::variant<double, InverseResult, Matrix, std::shared_ptr<const LUDecomposition>>;
+
+		struct Entry {
+			operation op;
+			uint64_t hash;
+			Matrix key;
+			Value value;
+			size_t bytes;
+		};
+
+		struct KeyHash {
+			size_t operator()(const std::pair<int, uint64_t>& key) const {
+				return static_cast<size_t>(key.second ^ (static_cast<uint64_t>(key.first) << 61));
+			}
+		};
+
+		mutable std::mutex _mutex;
+		size_t _capacity;
+		std::list<Entry> _entries;
+		std::unordered_map<std::pair<int, uint64_t>, std::list<Entry>::iterator, KeyHash> _index;
+		Statistics _stats;
+
+		bool lookup(operation op, uint64_t hash, const Matrix& A, Value* value);
+		void store(operation op, uint64_t hash, const Matrix& A, Value value, size_t valueBytes);
+		void evict();
+
+	public:
+
+		explicit MatrixCache(size_t capacityBytes = 0) : _capacity(capacityBytes) {}
+
+		static MatrixCache& global();
+
+		void setCapacity(size_t capacityBytes);
+		size_t capacity() const;
+		void clear();
+		Statistics statistics() const;
+
+		double determinant(const Matrix A);
+		InverseResult invert(const Matrix A);
+		Matrix adjugate(const Matrix A);
+		std::shared_ptr<const LUDecomposition> lu(const Matrix A);
+	};
+}
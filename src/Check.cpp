@@ -0,0 +1,920 @@
+#include "Check.h"
+#include "Matrix.h"
+#include "Banded.h"
+#include "Cache.h"
+#include "Exact.h"
+#include "LU.h"
+#include "MixedPrecision.h"
+#include "OutOfCore.h"
+#include "QR.h"
+#include "Reductions.h"
+#include "Spectral.h"
+#include "Update.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Randomized property checks of the numerical routines, run with the
+/// --check command line option. Every group draws matrices of chosen
+/// structures, checks algebraic identities whose tolerance scales with the
+/// size and the condition number, and is timed so that a throughput
+/// regression against a recorded baseline fails the run.
+/// </summary>
+
+namespace als {
+
+	namespace {
+
+		constexpr double eps = std::numeric_limits<double>::epsilon();
+
+		enum class structure {
+			GENERAL,
+			DIAGONAL,
+			UPPER_TRIANGULAR,
+			LOWER_TRIANGULAR,
+			SPD,
+			ILL_CONDITIONED,
+			SINGULAR,
+			INTEGER,
+			BANDED,
+			BLOCK_TRIDIAGONAL,
+		};
+
+		/// Bandwidths of the banded matrices and block size of the block tridiagonal ones
+		constexpr int lowerBandwidth = 2, upperBandwidth = 3, blockSize = 4;
+
+		const char* structureName(structure s) {
+			switch (s) {
+			case structure::GENERAL: return "general";
+			case structure::DIAGONAL: return "diagonal";
+			case structure::UPPER_TRIANGULAR: return "upper";
+			case structure::LOWER_TRIANGULAR: return "lower";
+			case structure::SPD: return "spd";
+			case structure::ILL_CONDITIONED: return "ill";
+			case structure::SINGULAR: return "singular";
+			case structure::INTEGER: return "integer";
+			case structure::BANDED: return "banded";
+			case structure::BLOCK_TRIDIAGONAL: return "blocktridiagonal";
+			}
+			return "?";
+		}
+
+		const structure invertibleStructures[] = {
+			structure::GENERAL, structure::DIAGONAL, structure::UPPER_TRIANGULAR,
+			structure::LOWER_TRIANGULAR, structure::SPD, structure::ILL_CONDITIONED,
+		};
+
+		Matrix randomMatrix(int m, int n, std::mt19937& generator) {
+
+			std::uniform_real_distribution<double> distribution(-1, 1);
+			Matrix A(m, n);
+
+			for (int a = 0; a < m * n; a++) A(a) = distribution(generator);
+
+			return A;
+		}
+
+		/**
+		* Q factor of the QR factorization of a random square matrix.
+		*/
+		Matrix randomOrthogonal(int n, std::mt19937& generator) {
+			QRDecomposition qr(randomMatrix(n, n, generator), false);
+			return qr.applyQTranspose(Matrix::Identity(n)).transpose();
+		}
+
+		/**
+		* Random n x n matrix of the structure. Triangular and diagonal
+		* matrices get diagonals away from zero, the ill-conditioned ones have
+		* singular values spread from 1 to 1e-10, the singular ones rank n / 2.
+		* The block tridiagonal ones, of blocks of blockSize, are strictly
+		* diagonally dominant so that they need no pivoting between blocks.
+		*/
+		Matrix generate(structure s, int n, std::mt19937& generator) {
+
+			std::uniform_real_distribution<double> magnitude(0.5, 2);
+			Matrix A = randomMatrix(n, n, generator);
+
+			switch (s) {
+			case structure::GENERAL:
+				break;
+
+			case structure::DIAGONAL:
+			case structure::UPPER_TRIANGULAR:
+			case structure::LOWER_TRIANGULAR:
+				for (int j = 0; j < n; j++) {
+					for (int i = 0; i < n; i++) {
+						bool keep = s == structure::UPPER_TRIANGULAR ? i >= j
+							: s == structure::LOWER_TRIANGULAR ? i <= j : i == j;
+						if (!keep) A(j, i) = 0;
+					}
+					A(j, j) = A(j, j) < 0 ? -magnitude(generator) : magnitude(generator);
+				}
+				break;
+
+			case structure::SPD: {
+				A = A.transpose() * A;
+				for (int j = 0; j < n; j++) A(j, j) += n;
+				// Exactly symmetric despite the rounding of the product
+				for (int j = 0; j < n; j++) {
+					for (int i = 0; i < j; i++) A(j, i) = A(i, j);
+				}
+				break;
+			}
+
+			case structure::ILL_CONDITIONED: {
+				Matrix U = randomOrthogonal(n, generator);
+				Matrix V = randomOrthogonal(n, generator);
+				for (int i = 0; i < n; i++) {
+					const double sigma = std::pow(10.0, n > 1 ? -10.0 * i / (n - 1) : 0);
+					for (int j = 0; j < n; j++) U(j, i) *= sigma;
+				}
+				A = U * V.transpose();
+				break;
+			}
+
+			case structure::SINGULAR: {
+				const int r = std::max(1, n / 2);
+				A = randomMatrix(n, r, generator) * randomMatrix(r, n, generator);
+				break;
+			}
+
+			case structure::INTEGER: {
+				std::uniform_int_distribution<int> digits(-9, 9);
+				for (int a = 0; a < n * n; a++) A(a) = digits(generator);
+				break;
+			}
+
+			case structure::BANDED:
+				for (int j = 0; j < n; j++) {
+					for (int i = 0; i < n; i++) {
+						if (j - i > lowerBandwidth || i - j > upperBandwidth) A(j, i) = 0;
+					}
+				}
+				break;
+
+			case structure::BLOCK_TRIDIAGONAL:
+				for (int j = 0; j < n; j++) {
+					for (int i = 0; i < n; i++) {
+						if (std::abs(j / blockSize - i / blockSize) > 1) A(j, i) = 0;
+					}
+					A(j, j) += A(j, j) < 0 ? -3 * blockSize : 3 * blockSize;
+				}
+				break;
+			}
+
+			return A;
+		}
+
+		/**
+		* Outcome of the cases of one group.
+		*/
+		struct GroupResult {
+			std::string name;
+			int cases = 0;
+			int failures = 0;
+			double seconds = 0;
+		};
+
+		/**
+		* Context handed to the checks of a case, collecting the failures.
+		*/
+		class CaseContext {
+
+			std::ostream& _out;
+			GroupResult& _group;
+			std::string _description;
+			bool _report;
+
+		public:
+
+			std::mt19937 generator;
+
+			CaseContext(std::ostream& out, GroupResult& group, uint32_t seed, bool report)
+				: _out(out), _group(group), _report(report), generator(seed) {}
+
+			void describe(structure s, int n, uint32_t seed) {
+				std::ostringstream description;
+				description << structureName(s) << " n=" << n << " seed=" << seed;
+				_description = description.str();
+			}
+
+			/**
+			* Record a failure when the error is above the tolerance or not a number.
+			*/
+			void expect(const char* identity, double error, double tolerance) {
+
+				if (error <= tolerance || !_report) return;
+
+				_group.failures++;
+				_out << "FAIL " << _group.name << " [" << _description << "] " << identity
+					<< ": error " << error << " > tolerance " << tolerance << "\n";
+			}
+
+			void expect(const char* identity, bool holds) {
+				expect(identity, holds ? 0.0 : 1.0, 0.5);
+			}
+		};
+
+		using caseFunction = std::function<void(CaseContext&, structure, int)>;
+
+		struct Group {
+			const char* name;
+			std::vector<structure> structures;
+			std::vector<int> sizes;
+			caseFunction check;
+		};
+
+		/*** Identities ***/
+
+		/**
+		* A * A^-1 = I, the inverse against LU solves of the columns of I.
+		*/
+		void inverseIdentity(CaseContext& c, structure s, int n) {
+
+			Matrix A = generate(s, n, c.generator);
+			InverseResult inverse = Matrix::invert(A);
+
+			c.expect("invertible", inverse.status == resultStatus::OK);
+			c.expect("isInvertible agrees with invert", A.isInvertible() == (inverse.status == resultStatus::OK));
+			if (inverse.status != resultStatus::OK) return;
+
+			const double tolerance = 100 * n * eps * A.conditionNumber();
+			c.expect("A * inv(A) = I", reductions::maxNorm(A * inverse.inverse + Matrix::Identity(n) * -1), tolerance);
+		}
+
+		/**
+		* det(A * B) = det(A) * det(B), and the LU determinant against the row
+		* echelon reference.
+		*/
+		void determinantIdentity(CaseContext& c, structure s, int n) {
+
+			Matrix A = generate(s, n, c.generator);
+			Matrix B = generate(s, n, c.generator);
+
+			const double detA = Matrix::determinant(A);
+			const double detB = Matrix::determinant(B);
+			const double detAB = Matrix::determinant(A * B);
+			const double scale = std::abs(detA * detB);
+			const double tolerance = 100 * n * eps * (A.conditionNumber() + B.conditionNumber());
+
+			c.expect("det(AB) = det(A) det(B)", std::abs(detAB - detA * detB) / scale, tolerance);
+
+			double alpha = 0;
+			Matrix echelon = Matrix::toRowEchelon(A, nullptr, &alpha);
+			c.expect("det(A) = echelon det(A)",
+				std::abs(Matrix::determinant(echelon, alpha) - detA) / std::abs(detA), 100 * n * eps * A.conditionNumber());
+		}
+
+		/**
+		* adj(A) * A = det(A) * I.
+		*/
+		void adjugateIdentity(CaseContext& c, structure s, int n) {
+
+			Matrix A = generate(s, n, c.generator);
+			const double det = Matrix::determinant(A);
+
+			Matrix residual = Matrix::adjugate(A) * A + Matrix::Identity(n) * -det;
+			const double tolerance = 1000 * n * eps * A.conditionNumber() * std::max(std::abs(det), reductions::maxNorm(A));
+
+			c.expect("adj(A) A = det(A) I", reductions::maxNorm(residual), tolerance);
+		}
+
+		/**
+		* Rank deficient matrices: reported singular, rank n / 2.
+		*/
+		void singularIdentity(CaseContext& c, structure s, int n) {
+
+			Matrix A = generate(s, n, c.generator);
+
+			c.expect("rank(A) = n / 2", A.rank() == std::max(1, n / 2));
+			c.expect("not invertible", !A.isInvertible());
+			c.expect("inverse refused", Matrix::invert(A).status == resultStatus::SINGULAR);
+		}
+
+		/**
+		* A * x = b solved through the reduced row echelon form for a known x,
+		* and the row echelon form has its pivots in increasing columns.
+		*/
+		void sleIdentity(CaseContext& c, structure s, int n) {
+
+			Matrix A = generate(s, n, c.generator);
+			Matrix x = randomMatrix(n, 1, c.generator);
+			Matrix b = A * x;
+
+			SleResult result = Matrix::solve(A, b);
+
+			c.expect("unique solution", result.kind == sleSolution::ONE);
+			c.expect("|A x - b|", result.residual, 100 * n * eps * reductions::normInf(A) * reductions::maxNorm(result.general.particular));
+
+			Matrix echelon = Matrix::toRowEchelon(A);
+			int previous = -1;
+			bool staircase = true;
+			for (int j = 0; j < n; j++) {
+				int lead = 0;
+				while (lead < n && echelon(j, lead) == 0) lead++;
+				if (lead < n && lead <= previous) staircase = false;
+				if (lead < n) previous = lead;
+			}
+			c.expect("row echelon staircase", staircase);
+		}
+
+		/**
+		* The structure predicates recognize the generated structures.
+		*/
+		void structureIdentity(CaseContext& c, structure s, int n) {
+
+			Matrix A = generate(s, n, c.generator);
+
+			switch (s) {
+			case structure::DIAGONAL: c.expect("isDiagonal", A.isDiagonal()); break;
+			case structure::UPPER_TRIANGULAR: c.expect("isUpperTriangular", A.isUpperTriangular()); break;
+			case structure::LOWER_TRIANGULAR: c.expect("isLowerTriangular", A.isLowerTriangular()); break;
+			case structure::SPD: c.expect("isSymetric", A.isSymetric()); break;
+			default: break;
+			}
+
+			c.expect("transpose twice", A.transpose().transpose() == A);
+			c.expect("A - A^T antisymetric", (A + A.transpose() * -1).isAntisymetric());
+		}
+
+		/**
+		* Floating determinant against the exact one of integer matrices.
+		*/
+		void exactIdentity(CaseContext& c, structure s, int n) {
+
+			Matrix A = generate(s, n, c.generator);
+			ExactDeterminant exact = exactDeterminant(A);
+
+			c.expect("exact determinant", exact.status == resultStatus::OK);
+
+			const double reference = exact.value.toDouble();
+			const double error = std::abs(Matrix::determinant(A) - reference);
+
+			if (reference == 0) c.expect("det(A) = exact", error, 100 * n * eps * std::pow(reductions::normInf(A), n));
+			else c.expect("det(A) = exact", error / std::abs(reference), 100 * n * eps * A.conditionNumber());
+		}
+
+		/**
+		* Exact solution of integer systems built from a known integer solution,
+		* and against the floating solution of the same system.
+		*/
+		void exactSolveIdentity(CaseContext& c, structure s, int n) {
+
+			Matrix A = generate(s, n, c.generator);
+
+			std::uniform_int_distribution<int> digits(-9, 9);
+			Matrix x(n, 2);
+			for (int a = 0; a < 2 * n; a++) x(a) = digits(c.generator);
+
+			ExactSolution exact = exactSolve(A, A * x);
+
+			if (exactDeterminant(A).value.isZero()) {
+				c.expect("singular system", exact.status == resultStatus::SINGULAR);
+				return;
+			}
+
+			c.expect("exact solution", exact.status == resultStatus::OK);
+			if (exact.status != resultStatus::OK) return;
+
+			const double denominator = exact.denominator.toDouble();
+			double error = 0;
+			for (int a = 0; a < 2 * n; a++) {
+				error = std::max(error, std::abs(exact.numerators[a].toDouble() / denominator - x(a)));
+			}
+			c.expect("numerators / det(A) = x", error, 4 * eps * std::max(1.0, reductions::maxNorm(x)));
+
+			Matrix first(n, 1);
+			for (int j = 0; j < n; j++) first(j) = x(j, 0);
+
+			SleResult floating = Matrix::solve(A, A * first);
+
+			c.expect("floating unique solution", floating.kind == sleSolution::ONE);
+			if (floating.kind != sleSolution::ONE) return;
+
+			error = 0;
+			for (int j = 0; j < n; j++) {
+				error = std::max(error, std::abs(floating.general.particular(j) - exact.numerators[j * 2].toDouble() / denominator));
+			}
+			c.expect("solve = exact", error, 100 * n * eps * A.conditionNumber() * std::max(1.0, reductions::maxNorm(first)));
+		}
+
+		/**
+		* Out-of-core product, transpose, LU and solve against the in-core ones,
+		* with tiles that don't divide the sizes so that the last tile column
+		* and row are partial.
+		*/
+		void outOfCoreIdentity(CaseContext& c, structure s, int n) {
+
+			const int m = n + 3;
+			const int tile = n / 3 + 1;
+
+			Matrix A = randomMatrix(n, m, c.generator);
+			Matrix B = randomMatrix(m, n, c.generator);
+
+			TiledMatrix tiledA = TiledMatrix::temporary(n, m, tile);
+			TiledMatrix tiledB = TiledMatrix::temporary(m, n, tile);
+			TiledMatrix product = TiledMatrix::temporary(n, n, tile);
+			TiledMatrix transposed = TiledMatrix::temporary(m, n, tile);
+
+			c.expect("fill tiles", tiledA.fill(A) && tiledB.fill(B));
+
+			Matrix result(1, 1);
+
+			c.expect("out-of-core product", outOfCoreMultiply(tiledA, tiledB, product) == resultStatus::OK && product.toMatrix(&result));
+			c.expect("|A B - product|", reductions::maxNorm(result + (A * B) * -1),
+				100 * m * eps * reductions::normInf(A) * reductions::normInf(B));
+
+			c.expect("out-of-core transpose", outOfCoreTranspose(tiledA, transposed) == resultStatus::OK && transposed.toMatrix(&result));
+			c.expect("transpose = A^T", result == A.transpose());
+
+			Matrix square = generate(s, n, c.generator);
+			TiledMatrix factors = TiledMatrix::temporary(n, n, tile);
+			std::vector<int> pivots;
+
+			c.expect("fill square tiles", factors.fill(square));
+			c.expect("out-of-core LU", outOfCoreLU(factors, &pivots) == resultStatus::OK && factors.toMatrix(&result));
+
+			LUDecomposition lu(square);
+			const double condition = lu.conditionEstimate();
+
+			int sign = 1;
+			for (int i = 0; i < n; i++) if (pivots[i] != i) sign = -sign;
+
+			const double reference = lu.determinant();
+			c.expect("det(U) = LU determinant", std::abs(Matrix::determinant(result, sign) - reference) / std::abs(reference),
+				100 * n * eps * condition);
+
+			Matrix x = randomMatrix(n, 2, c.generator);
+			Matrix solution(1, 1);
+
+			c.expect("out-of-core solve", outOfCoreLUSolve(factors, pivots, square * x, &solution) == resultStatus::OK);
+			c.expect("solve = LU solve", reductions::maxNorm(solution + lu.solve(square * x) * -1),
+				100 * n * eps * condition * reductions::maxNorm(x));
+		}
+
+		/**
+		* The inverse and determinant maintained through an update against a new
+		* LU factorization of the updated matrix.
+		*/
+		void expectRefactored(CaseContext& c, const UpdatableInverse& updated, resultStatus status, const std::string& step) {
+
+			const Matrix& A = updated.matrix();
+			const int n = A.rowCount();
+
+			// The updates only keep the backward error of the inverse under sqrt(eps)
+			LUDecomposition lu(A);
+			const double tolerance = 100 * n * std::sqrt(eps) * lu.conditionEstimate();
+
+			c.expect((step + " status").c_str(), status == resultStatus::OK && updated.status() == resultStatus::OK);
+			if (status != resultStatus::OK) return;
+
+			Matrix inverse = lu.solve(Matrix::Identity(n));
+			c.expect((step + " inverse").c_str(), reductions::maxNorm(updated.inverse() + inverse * -1) / reductions::maxNorm(inverse), tolerance);
+
+			const double determinant = lu.determinant();
+			c.expect((step + " determinant").c_str(), std::abs(updated.determinant() - determinant) / std::abs(determinant), tolerance);
+		}
+
+		/**
+		* Entry, row, column and rank k updates of an inverse, down to a singular
+		* matrix and back.
+		*/
+		void updateIdentity(CaseContext& c, structure s, int n) {
+
+			Matrix A = generate(s, n, c.generator);
+			UpdatableInverse updated(A);
+
+			expectRefactored(c, updated, updated.status(), "construction");
+
+			std::uniform_int_distribution<int> index(0, n - 1);
+			std::uniform_real_distribution<double> value(-1, 1);
+
+			const int j = index(c.generator), i = index(c.generator);
+
+			expectRefactored(c, updated, updated.setEntry(j, i, value(c.generator)), "setEntry");
+			expectRefactored(c, updated, updated.setRow(j, randomMatrix(1, n, c.generator)), "setRow");
+			expectRefactored(c, updated, updated.setColumn(i, randomMatrix(n, 1, c.generator)), "setColumn");
+
+			const int k = std::min(n, 3);
+			expectRefactored(c, updated, updated.rankKUpdate(randomMatrix(n, k, c.generator), randomMatrix(n, k, c.generator)), "rankKUpdate");
+
+			c.expect("size mismatch", updated.rankKUpdate(randomMatrix(n + 1, k, c.generator), randomMatrix(n, k, c.generator))
+				== resultStatus::SIZE_MISMATCH);
+
+			// A zero row makes the matrix singular, the previous one brings it back
+			Matrix row(1, n), zero(1, n);
+			for (int l = 0; l < n; l++) {
+				row(l) = updated.matrix()(j, l);
+				zero(l) = 0;
+			}
+
+			c.expect("singular update", updated.setRow(j, zero) == resultStatus::SINGULAR && updated.isSingular());
+
+			expectRefactored(c, updated, updated.setRow(j, row), "recovery");
+		}
+
+		/**
+		* Largest difference between U^T * U and the identity.
+		*/
+		double orthogonalityError(const Matrix& U) {
+			return reductions::maxNorm(U.transpose() * U + Matrix::Identity(U.colCount()) * -1);
+		}
+
+		/**
+		* Columns of U scaled by the values, U * diag(values).
+		*/
+		Matrix scaledColumns(const Matrix& U, const std::vector<double>& values) {
+
+			Matrix scaled = U;
+			const Matrix::Writable element = scaled.writable();
+
+			for (int j = 0; j < U.rowCount(); j++) {
+				for (int i = 0; i < U.colCount(); i++) element(j, i) *= values[i];
+			}
+
+			return scaled;
+		}
+
+		/**
+		* Symmetric eigen decomposition A * V = V * diag(values) with V orthogonal,
+		* Jacobi SVD U * diag(values) * V^T = A of a tall and a wide matrix with
+		* sorted values, and the Lanczos largest values against the dense ones.
+		*/
+		void spectralIdentity(CaseContext& c, structure s, int n) {
+
+			Matrix A = generate(s, n, c.generator);
+			Matrix S = A + A.transpose();
+			const double normS = reductions::normInf(S);
+
+			SymmetricEigenDecomposition eigen(S);
+			const std::vector<double>& lambda = eigen.values();
+
+			c.expect("eigen converged", eigen.status() == resultStatus::OK && eigen.converged());
+			c.expect("A * V = V * diag(values)", reductions::maxNorm(S * eigen.vectors() + scaledColumns(eigen.vectors(), lambda) * -1),
+				100 * n * eps * normS);
+			c.expect("V^T * V = I", orthogonalityError(eigen.vectors()), 100 * n * eps);
+			c.expect("eigenvalues ascending", std::is_sorted(lambda.begin(), lambda.end()));
+
+			// The Lanczos iteration stops on Ritz residuals under 1e-10 of the spectrum
+			const int k = std::min(n, 3);
+			SymmetricEigenDecomposition top = SymmetricEigenDecomposition::largest(S, k);
+
+			double error = 0;
+			for (int i = 0; i < k; i++) error = std::max(error, std::abs(top.values()[i] - lambda[n - 1 - i]));
+			c.expect("Lanczos largest = dense", error, 1e-9 * normS);
+
+			for (Matrix B : { Matrix(randomMatrix(n + 2, n, c.generator) * A), Matrix(A * randomMatrix(n, n + 2, c.generator)) }) {
+
+				SingularValueDecomposition svd(B);
+				const std::vector<double>& sigma = svd.values();
+
+				c.expect("U * diag(values) * V^T = A", reductions::maxNorm(scaledColumns(svd.U(), sigma) * svd.V().transpose() + B * -1),
+					100 * n * eps * reductions::normInf(B));
+				// V accumulates the rotations of a tall matrix, a wide one gets the normalized columns of U instead
+				if (B.rowCount() > B.colCount()) c.expect("V^T * V = I", orthogonalityError(svd.V()), 100 * n * eps);
+				c.expect("singular values descending", std::is_sorted(sigma.rbegin(), sigma.rend()) && sigma.back() >= 0);
+			}
+		}
+
+		/**
+		* Least squares solution of an overdetermined system: the residual is
+		* orthogonal to the columns, A^T * (A * x - b) = 0, and on well
+		* conditioned matrices x matches the normal equations A^T * A * x = A^T * b.
+		*/
+		void leastSquaresIdentity(CaseContext& c, structure s, int n) {
+
+			const int m = 2 * n + 1;
+
+			Matrix A = randomMatrix(m, n, c.generator) * generate(s, n, c.generator);
+			Matrix b = randomMatrix(m, 1, c.generator);
+			Matrix At = A.transpose();
+
+			Matrix x = Matrix::leastSquares(A, b);
+
+			c.expect("A^T * (A * x - b) = 0", reductions::maxNorm(At * (A * x + b * -1)),
+				100 * m * eps * reductions::normInf(At) * (reductions::normInf(A) * reductions::maxNorm(x) + reductions::maxNorm(b)));
+
+			if (s == structure::ILL_CONDITIONED) return;
+
+			Matrix normal = At * A;
+			Matrix y = LUDecomposition(normal).solve(At * b);
+
+			c.expect("x = normal equations", reductions::maxNorm(x + y * -1),
+				100 * m * eps * normal.conditionNumber() * reductions::maxNorm(y));
+		}
+
+		/**
+		* log|det(c A)| = n log c + log|det(A)| far beyond the range of doubles.
+		*/
+		void logDeterminantIdentity(CaseContext& c, structure s, int n) {
+
+			Matrix A = generate(s, n, c.generator);
+			const double scale = 1e20;
+
+			LogDeterminant plain = Matrix::logDeterminant(A);
+			LogDeterminant scaled = Matrix::logDeterminant(A * scale);
+
+			c.expect("sign(det(cA)) = sign(det(A))", plain.sign == scaled.sign);
+			c.expect("log|det(cA)| = n log c + log|det(A)|",
+				std::abs(scaled.logAbs - plain.logAbs - n * std::log(scale)), 1e-8 * n * std::log(scale));
+		}
+
+		/**
+		* Strassen-Winograd against the blocked product.
+		*/
+		void productIdentity(CaseContext& c, structure s, int n) {
+
+			Matrix A = generate(s, n, c.generator);
+			Matrix B = generate(s, n, c.generator);
+
+			Matrix classic = Matrix::product(A, B, productAlgorithm::CLASSIC);
+			Matrix strassen = Matrix::product(A, B, productAlgorithm::STRASSEN);
+
+			c.expect("Strassen = classic", reductions::maxNorm(strassen + classic * -1) / reductions::maxNorm(classic), 1000 * n * eps);
+		}
+
+		/**
+		* Mixed precision refinement against the double LU solve: the backward
+		* error reaches the same level, through the refinement or the fallback.
+		*/
+		void mixedIdentity(CaseContext& c, structure s, int n) {
+
+			Matrix A = generate(s, n, c.generator);
+			Matrix b = A * randomMatrix(n, 1, c.generator);
+
+			RefinedSolution mixed = solveMixedPrecision(A, b);
+			const double reference = backwardError(A, LUDecomposition(A).solve(b), b);
+
+			c.expect("mixed backward error", mixed.backwardError, std::max(std::sqrt(n) * eps, 10 * reference));
+			c.expect("reported backward error", mixed.backwardError == backwardError(A, mixed.x, b));
+
+			SleResult result = Matrix::solve(A, b, solvePrecision::MIXED);
+			const double det = Matrix::determinant(A);
+
+			c.expect("unique solution", result.kind == sleSolution::ONE);
+			c.expect("|A x - b|", result.backwardError, std::max(std::sqrt(n) * eps, 10 * reference));
+
+			// Underflowing determinants are flushed to 0 by the double path only
+			if (det != 0) {
+				c.expect("mixed determinant", std::abs(result.determinant - det) / std::abs(det),
+					100 * n * std::numeric_limits<float>::epsilon() * A.conditionNumber());
+			}
+		}
+
+		/**
+		* Copies and snapshots share their storage until one side is written
+		* to: a write through either side never shows through the other.
+		*/
+		void copyOnWriteIdentity(CaseContext& c, structure s, int n) {
+
+			Matrix A = generate(s, n, c.generator);
+			const Matrix original = A.clone();
+
+			Matrix copy = A;
+			copy(0, 0) += 1;
+			c.expect("write through a copy", A == original && !(copy == original));
+
+			const Matrix snapshot = A.snapshot();
+			A(n - 1, n - 1) += 1;
+			c.expect("write after a snapshot", snapshot == original);
+			A = snapshot;
+
+			Matrix scaled = A;
+			scaled.scaleEquation(0, 2);
+			c.expect("scaleEquation on a copy", A == original);
+
+			Matrix swapped = A;
+			swapped.swapEquations(0, n - 1);
+			swapped.addOtherEquation(0, n - 1, 1);
+			c.expect("swapEquations on a copy", A == original);
+
+			Matrix pointers = A;
+			pointers.data()[0] += 1;
+			pointers.row(n - 1)[n - 1] += 1;
+			c.expect("write through data() of a copy", A == original);
+
+			Matrix viewed = A;
+			viewed.writable()(n - 1, 0) += 1;
+			viewed.transposeInPlace();
+			c.expect("write through a view of a copy", A == original);
+
+			// The keys and results of the cache share their storage with its callers
+			MatrixCache cache(1 << 20);
+			Matrix key = A;
+			const Matrix adjugate = cache.adjugate(key);
+
+			Matrix hit = cache.adjugate(key);
+			hit(0, 0) += 1;
+			key(0, 0) += 1;
+			c.expect("write into a cached result", cache.adjugate(A) == adjugate);
+			c.expect("cached key unchanged", cache.statistics().hits == 2);
+		}
+
+		/**
+		* Relative distance between two determinants given as mantissa * 2^exponent.
+		*/
+		double scaledDistance(double mantissa, long long exponent, double reference, long long referenceExponent) {
+			return std::abs(std::ldexp(mantissa, static_cast<int>(exponent - referenceExponent)) - reference) / std::abs(reference);
+		}
+
+		/**
+		* Band and block tridiagonal LU against the dense LU: same determinant
+		* and same solution.
+		*/
+		void bandedIdentity(CaseContext& c, structure s, int n) {
+
+			Matrix A = generate(s, n, c.generator);
+			Matrix b = randomMatrix(n, 2, c.generator);
+
+			LUDecomposition dense(A);
+			Matrix x = dense.solve(b);
+
+			long long exponent, referenceExponent;
+			const double reference = dense.scaledDeterminant(&referenceExponent);
+			const double tolerance = 100 * n * eps * A.conditionNumber();
+
+			if (s == structure::BANDED) {
+
+				BandMatrix band = BandMatrix::fromMatrix(A);
+				c.expect("bandwidths", band.lowerBandwidth() <= lowerBandwidth && band.upperBandwidth() <= upperBandwidth);
+
+				BandLUDecomposition lu(band);
+				const double mantissa = lu.scaledDeterminant(&exponent);
+				c.expect("band det = dense det", scaledDistance(mantissa, exponent, reference, referenceExponent), tolerance);
+				c.expect("band solve = dense solve", reductions::maxNorm(lu.solve(b) + x * -1) / reductions::maxNorm(x), tolerance);
+				return;
+			}
+
+			BlockTridiagonal blocks(0, blockSize);
+			c.expect("block tridiagonal", BlockTridiagonal::fromMatrix(A, blockSize, &blocks));
+
+			BlockTridiagonalLU lu(blocks);
+			c.expect("block nonsingular", !lu.isSingular());
+			const double mantissa = lu.scaledDeterminant(&exponent);
+			c.expect("block det = dense det", scaledDistance(mantissa, exponent, reference, referenceExponent), tolerance);
+			c.expect("block solve = dense solve", reductions::maxNorm(lu.solve(b) + x * -1) / reductions::maxNorm(x), tolerance);
+		}
+
+		std::vector<Group> groups() {
+
+			const std::vector<structure> invertible(std::begin(invertibleStructures), std::end(invertibleStructures));
+			const std::vector<structure> wellConditioned = {
+				structure::GENERAL, structure::DIAGONAL, structure::UPPER_TRIANGULAR,
+				structure::LOWER_TRIANGULAR, structure::SPD,
+			};
+
+			return {
+				{ "inverse", invertible, { 1, 2, 3, 5, 8, 16, 40 }, inverseIdentity },
+				{ "determinant", wellConditioned, { 1, 2, 3, 5, 8, 16, 40 }, determinantIdentity },
+				{ "adjugate", invertible, { 1, 2, 3, 4, 6 }, adjugateIdentity },
+				{ "singular", { structure::SINGULAR }, { 2, 3, 5, 8, 16, 40 }, singularIdentity },
+				{ "sle", wellConditioned, { 1, 2, 3, 5, 8, 16, 40 }, sleIdentity },
+				{ "structure", invertible, { 1, 2, 5, 16 }, structureIdentity },
+				{ "exact", { structure::INTEGER }, { 1, 2, 3, 5, 8, 12 }, exactIdentity },
+				{ "exactsolve", { structure::INTEGER }, { 1, 2, 3, 5, 8, 12 }, exactSolveIdentity },
+				{ "logdet", { structure::GENERAL, structure::SPD }, { 20, 60, 120 }, logDeterminantIdentity },
+				{ "product", { structure::GENERAL }, { 129, 200 }, productIdentity },
+				{ "mixed", invertible, { 1, 2, 5, 16, 40, 100 }, mixedIdentity },
+				{ "banded", { structure::BANDED, structure::BLOCK_TRIDIAGONAL }, { 4, 8, 16, 40, 100, 200 }, bandedIdentity },
+				{ "cow", { structure::GENERAL }, { 1, 2, 5, 16 }, copyOnWriteIdentity },
+				{ "leastsquares", { structure::GENERAL, structure::SPD, structure::ILL_CONDITIONED }, { 1, 2, 5, 16, 40, 100 }, leastSquaresIdentity },
+				{ "spectral", { structure::GENERAL, structure::SPD, structure::ILL_CONDITIONED, structure::SINGULAR }, { 1, 2, 5, 16, 40, 100 }, spectralIdentity },
+				{ "update", invertible, { 1, 2, 5, 16, 40 }, updateIdentity },
+				{ "outofcore", { structure::GENERAL, structure::SPD }, { 1, 7, 33, 61, 101 }, outOfCoreIdentity },
+			};
+		}
+
+		constexpr int casesPerSize = 4;
+
+		/**
+		* Run every case of the group once. Only the first run reports.
+		*/
+		void runGroup(const Group& group, GroupResult& result, uint32_t seed, bool report, std::ostream& out) {
+
+			uint32_t caseSeed = seed;
+
+			for (structure s : group.structures) {
+				for (int n : group.sizes) {
+					for (int k = 0; k < casesPerSize; k++) {
+						CaseContext context(out, result, caseSeed, report);
+						context.describe(s, n, caseSeed);
+						group.check(context, s, n);
+						caseSeed = caseSeed * 1664525u + 1013904223u;
+						if (report) result.cases++;
+					}
+				}
+			}
+		}
+
+		std::map<std::string, double> readBaseline(const std::string& path) {
+
+			std::map<std::string, double> baseline;
+			std::ifstream in(path);
+			std::string name;
+			double throughput;
+
+			while (in >> name >> throughput) baseline[name] = throughput;
+
+			return baseline;
+		}
+	}
+
+	/**
+	* Options following --check: --seed n, --repeat n, --threshold fraction,
+	* --baseline file and --record file.
+	*/
+	CheckOptions parseCheckOptions(int argc, char* argv[], int first) {
+
+		CheckOptions options;
+
+		// Unknown arguments, such as the options of the other modes, are skipped
+		for (int a = first; a + 1 < argc; a++) {
+			if (std::strcmp(argv[a], "--seed") == 0) options.seed = static_cast<uint32_t>(std::strtoul(argv[++a], nullptr, 10));
+			else if (std::strcmp(argv[a], "--repeat") == 0) options.repetitions = std::max(1, std::atoi(argv[++a]));
+			else if (std::strcmp(argv[a], "--threshold") == 0) options.threshold = std::atof(argv[++a]);
+			else if (std::strcmp(argv[a], "--baseline") == 0) options.baseline = argv[++a];
+			else if (std::strcmp(argv[a], "--record") == 0) options.record = argv[++a];
+		}
+
+		return options;
+	}
+
+	/**
+	* Run every group, report the failures and the throughput of each group.
+	* The throughput is the number of cases per second of the fastest of the
+	* repetitions.
+	* @return 0 on success, 1 when an identity fails, 2 when a group is slower
+	* than its baseline by more than the threshold
+	*/
+	int runChecks(const CheckOptions& options, std::ostream& out) {
+
+		std::vector<GroupResult> results;
+		int failures = 0;
+		bool regressed = false;
+
+		const std::map<std::string, double> baseline = options.baseline.empty()
+			? std::map<std::string, double>() : readBaseline(options.baseline);
+
+		out << std::left << std::setw(14) << "group" << std::right << std::setw(8) << "cases"
+			<< std::setw(10) << "failed" << std::setw(14) << "cases/s" << std::setw(14) << "baseline" << "\n";
+
+		for (const Group& group : groups()) {
+
+			GroupResult& result = results.emplace_back();
+			result.name = group.name;
+			result.seconds = std::numeric_limits<double>::infinity();
+
+			for (int r = 0; r < options.repetitions; r++) {
+				auto start = std::chrono::steady_clock::now();
+				runGroup(group, result, options.seed, r == 0, out);
+				std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+				result.seconds = std::min(result.seconds, elapsed.count());
+			}
+
+			failures += result.failures;
+
+			const double throughput = result.cases / result.seconds;
+
+			out << std::left << std::setw(14) << result.name << std::right << std::setw(8) << result.cases
+				<< std::setw(10) << result.failures << std::fixed << std::setprecision(1) << std::setw(14) << throughput;
+
+			auto reference = baseline.find(result.name);
+			if (reference != baseline.end()) {
+				out << std::setw(14) << reference->second;
+				if (throughput < reference->second * (1 - options.threshold)) {
+					out << "  REGRESSION";
+					regressed = true;
+				}
+			}
+			out << std::defaultfloat << "\n";
+		}
+
+		if (!options.record.empty()) {
+			std::ofstream record(options.record);
+			for (const GroupResult& result : results) {
+				record << result.name << " " << std::setprecision(10) << result.cases / result.seconds << "\n";
+			}
+		}
+
+		if (failures > 0) {
+			out << failures << " identities failed\n";
+			return 1;
+		}
+
+		return regressed ? 2 : 0;
+	}
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+namespace als {
+
+	struct CheckOptions {
+		uint32_t seed = 1;
+		int repetitions = 3;
+		double threshold = 0.25;
+		std::string baseline;
+		std::string record;
+	};
+
+	CheckOptions parseCheckOptions(int argc, char* argv[], int first);
+	int runChecks(const CheckOptions& options, std::ostream& out);
+}
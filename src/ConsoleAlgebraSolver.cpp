@@ -1,5 +1,16 @@
 #include "Matrix.h"
 #include "StringHelper.h"
+#include "Instrumentation.h"
+#include "Benchmark.h"
+#include "Spectral.h"
+#include "Cache.h"
+#include "Exact.h"
+#include "Server.h"
+#include "Check.h"
+#include "Vector.h"
+
+#include <cstdlib>
+#include <cstring>
 
 using namespace als;
 
@@ -10,6 +21,12 @@ using namespace als;
 * - Add further functionality
 */
 
+/// Precision of the SLE and inversion menus, MIXED with --mixed
+solvePrecision menuPrecision = solvePrecision::DOUBLE;
+
+/// Exact rational results of the determinant and SLE menus for integer matrices, with --exact
+bool menuExact = false;
+
 /// Forward declarations ///
 void propertyMenu();
 void multiplicationMenu();
@@ -17,10 +34,38 @@ void SleMenu();
 void determinantMenu();
 void matrixInversionMenu();
 void matrixAdjugateMenu();
+void spectralMenu();
 Matrix matrixMenu();
 
-int main()
+int main(int argc, char* argv[])
 {
+	ALS_PROFILE_DUMP_AT_EXIT();
+
+	// Options shared by every mode, at any position
+	for (int a = 1; a < argc; a++) {
+		if (std::strcmp(argv[a], "--mixed") == 0) menuPrecision = solvePrecision::MIXED;
+		else if (std::strcmp(argv[a], "--exact") == 0) menuExact = true;
+		else if (std::strcmp(argv[a], "--cache") == 0 && a + 1 < argc) {
+			MatrixCache::global().setCapacity(std::strtoull(argv[++a], nullptr, 10) << 20);
+		}
+	}
+
+	for (int a = 1; a < argc; a++) {
+
+		if (std::strcmp(argv[a], "--bench") == 0) {
+			runBenchmarks(std::cout);
+			return 0;
+		}
+
+		if (std::strcmp(argv[a], "--check") == 0) {
+			return runChecks(parseCheckOptions(argc, argv, a + 1), std::cout);
+		}
+
+		if (std::strcmp(argv[a], "--serve") == 0 && a + 1 < argc) {
+			const bool workers = a + 2 < argc && std::strncmp(argv[a + 2], "--", 2) != 0;
+			return runServer(argv[a + 1], workers ? std::atoi(argv[a + 2]) : 0, std::cout);
+		}
+	}
 
 	std::cout << "    _    _            _                 ____        _\n"
 		<< "   / \\  | | __ _  ___| |__  _ __ __ _  / ___|  ___ | |_   _____ _ __\n"
@@ -44,6 +89,7 @@ int main()
 			<< "5. Determinant calculation\n"
 			<< "6. Invert matrix calculation\n"
 			<< "7. Adjugate matrix calculation\n"
+			<< "8. Spectral analysis\n"
 			<< std::endl
 			<< "--> ";
 
@@ -56,12 +102,12 @@ int main()
 				problem = std::stoi(input);
 			}
 			catch (std::invalid_argument) {}
-			if (problem < 1 || problem > 7) {
+			if (problem < 1 || problem > 8) {
 				std::cout
 					<< "This is not a valid option.\n" << std::endl
 					<< "--> ";
 			}
-		} while (problem < 1 || problem > 7);
+		} while (problem < 1 || problem > 8);
 
 		switch (problem) {
 		case 1: continueOperations = false; break;
@@ -71,6 +117,7 @@ int main()
 		case 5: determinantMenu(); break;
 		case 6: matrixInversionMenu(); break;
 		case 7: matrixAdjugateMenu(); break;
+		case 8: spectralMenu(); break;
 		default: {
 			std::cerr << "FATAL ERROR: A proper menu was not selected\n";
 			exit(-1);
@@ -202,8 +249,7 @@ void SleMenu() {
 	int equationCount = std::stoi(entry);
 
 	Matrix A(equationCount, varCount);
-	Matrix b(equationCount, 1);
-	Matrix x(1, varCount);
+	Vector b(equationCount);
 
 	for (int e = 0; e < equationCount; e++) {
 		std::cout
@@ -228,7 +274,7 @@ void SleMenu() {
 
 				std::from_chars(elements[varCount].data(),
 					elements[varCount].data() + elements[varCount].size(),
-					b(e - 1, 1));
+					b(e));
 
 				acceptedEntry = true;
 			}
@@ -242,9 +288,63 @@ void SleMenu() {
 	}
 
 	A.print();
-	b.print();
+	b.toMatrix().print();
+
+	if (menuExact) {
+		ExactSolution exact = exactSolve(A, b.toMatrix());
 
-	sleSolution solution = Matrix::solveSLE(A, b, &x);
+		if (exact.status == resultStatus::OK) {
+			std::cout << "Single solution to the SLE: x = n / " << exact.denominator << " with n =" << std::endl;
+			for (const BigInt& numerator : exact.numerators) std::cout << numerator << " ";
+			std::cout << "\n" << std::endl;
+			return;
+		}
+	}
+
+	SleResult result = Matrix::solve(A, b, menuPrecision);
+
+	switch (result.kind) {
+	case sleSolution::NONE: {
+		std::cout << "No solution to the SLE, it is incompatible." << std::endl;
+		result.reducedSystem.print();
+		break;
+	}
+	case sleSolution::ONE: {
+		std::cout << "Single solution to the SLE:" << std::endl;
+		result.general.particular.transpose().print();
+		std::cout << "Backward error: " << result.backwardError << "\n" << std::endl;
+		break;
+	}
+	case sleSolution::INFINITE: {
+		const ParametricSolution& general = result.general;
+
+		std::cout << "Infinite solutions to the SLE: x = p";
+		for (size_t f = 0; f < general.freeVariables.size(); f++) {
+			std::cout << " + t" << f + 1 << " * n" << f + 1;
+		}
+		std::cout << std::endl << "p = ";
+		general.particular.transpose().print();
+
+		Matrix basis = general.nullSpace.transpose();
+
+		for (int f = 0; f < basis.rowCount(); f++) {
+			Matrix n(1, basis.colCount());
+			n.fill(basis.row(f));
+
+			std::cout << "n" << f + 1 << " = ";
+			n.print();
+		}
+		break;
+	}
+	}
+
+	if (result.kind == sleSolution::NONE && equationCount > varCount) {
+
+		Matrix fit = Matrix::leastSquares(A, b.toMatrix());
+
+		std::cout << "Least squares solution (minimizes ||Ax - b||):" << std::endl;
+		fit.transpose().print();
+	}
 }
 
 void determinantMenu() {
@@ -257,7 +357,17 @@ void determinantMenu() {
 
 	Matrix A = matrixMenu();
 
-	double det = Matrix::determinant(A);
+	// The exact determinant grows like n^4, it is only computed on request
+	if (menuExact) {
+		ExactDeterminant exact = exactDeterminant(A);
+
+		if (exact.status == resultStatus::OK) {
+			std::cout << "Determinant(A) = " << exact.value << "\n" << std::endl;
+			return;
+		}
+	}
+
+	double det = MatrixCache::global().determinant(A);
 
 	std::cout << "Determinant(A) = " << det << "\n" << std::endl;
 
@@ -273,11 +383,20 @@ void matrixInversionMenu() {
 
 	Matrix A = matrixMenu();
 
-	Matrix invA = Matrix::inverse(A);
-
-	std::cout << "Inv(A) = \n";
-
-	invA.print();
+	InverseResult result = menuPrecision == solvePrecision::MIXED
+		? Matrix::invert(A, menuPrecision) : MatrixCache::global().invert(A);
+
+	switch (result.status) {
+	case resultStatus::NOT_SQUARE:
+		std::cout << "ERROR: The matrix to invert is not square. Thus there is no inverse matrix.\n" << std::endl;
+		break;
+	case resultStatus::SINGULAR:
+		std::cout << "Warning: the determinant of the matrix is equal to 0. Thus it can't be inverted.\n" << std::endl;
+		break;
+	default:
+		std::cout << "Inv(A) = \n";
+		result.inverse.print();
+	}
 }
 
 void matrixAdjugateMenu() {
@@ -290,13 +409,46 @@ void matrixAdjugateMenu() {
 
 	Matrix A = matrixMenu();
 
-	Matrix adjA = Matrix::adjugate(A);
+	Matrix adjA = MatrixCache::global().adjugate(A);
 
 	std::cout << "Adj(A) = \n";
 
 	adjA.print();
 }
 
+void spectralMenu() {
+
+	std::cout
+		<< "<====================>\n"
+		<< "  Spectral analysis: \n"
+		<< "<====================>\n"
+		<< " eig(A), svd(A)\n" << std::endl;
+
+	Matrix A = matrixMenu();
+
+	std::cout << "~~~~~ Result ~~~~~\n" << std::endl;
+
+	if (A.isSymetric()) {
+		SymmetricEigenDecomposition eigen(A);
+
+		if (!eigen.converged()) std::cerr << "WARNING: The eigenvalues did not all converge.\n" << std::endl;
+
+		std::cout << "Eigenvalues = ";
+		for (double value : eigen.values()) std::cout << value << " ";
+		std::cout << "\nEigenvectors (columns) = \n";
+		eigen.vectors().print();
+	}
+	else {
+		std::cout << "The matrix is not symetric, only its singular values are computed.\n";
+	}
+
+	SingularValueDecomposition svd(A, false);
+
+	std::cout << "Singular values = ";
+	for (double value : svd.values()) std::cout << value << " ";
+	std::cout << "\nCondition number = " << svd.conditionNumber() << "\n" << std::endl;
+}
+
 Matrix matrixMenu() {
 
 	std::string entry;
@@ -331,6 +483,8 @@ Matrix matrixMenu() {
 
 		if (elements.size() == w * h) {
 
+			ALS_PROFILE_SCOPE("matrixMenu.parse");
+
 			for (int i = 0; i < w * h; i++) {
 				std::from_chars(elements[i].data(),
 					elements[i].data() + elements[i].size(),
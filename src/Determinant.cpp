@@ -1,4 +1,13 @@
 #include "Matrix.h"
+#include "Instrumentation.h"
+#include "LU.h"
+#include "Cache.h"
+#include "Banded.h"
+#include "MixedPrecision.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
 /// <summary>
 /// Implementation of the determinants and inverse matrix.
@@ -6,25 +15,86 @@
 
 namespace als {
 
-	/**
-	* Calculate the determinant of the matrix.
-	* @param A matrix to calculate the determinant of
-	*/
-	double Matrix::determinant(const Matrix A) {
+	namespace {
 
-		if (!A.isSquare()) return 0;
+		/**
+		* Whether a pivot of the factors of A is under its elimination tolerance.
+		*/
+		bool flushedSingular(const LUDecomposition& lu, const Matrix& A) {
+
+			const double tolerance = Matrix::eliminationTolerance(A);
+
+			for (int i = 0; i < lu.size(); i++) {
+				if (std::abs(lu.packed()(i, i)) <= tolerance) return true;
+			}
+
+			return false;
+		}
+
+		/**
+		* Partially pivoted LU of A, from the cache, with the pivots under the
+		* elimination tolerance flushed to zero so that singular matrices read
+		* exactly 0. Narrow banded matrices are factored in band storage instead.
+		* @param cached false for one-off matrices such as cofactor minors, which
+		* are factored directly so that they don't evict the cached results
+		*/
+		ScaledDeterminant flushedDeterminant(const Matrix& A, bool cached = true) {
+
+			const double tolerance = Matrix::eliminationTolerance(A);
+
+			int kl, ku;
+			detectBandwidth(A, &kl, &ku);
+
+			if (4 * (2 * kl + ku + 1) < A.rowCount()) {
+
+				BandLUDecomposition band(BandMatrix::fromMatrix(A));
 
-		double alpha = 0;
+				for (int i = 0; i < band.size(); i++) {
+					if (std::abs(band.pivot(i)) <= tolerance) return { resultStatus::SINGULAR, 0, 0 };
+				}
 
-		Matrix reMat = Matrix::toRowEchelon(A, nullptr, &alpha);
+				long long exponent;
+				double mantissa = band.scaledDeterminant(&exponent);
 
-		double det = 1;
+				return { resultStatus::OK, mantissa, exponent };
+			}
+
+			std::shared_ptr<const LUDecomposition> lu = cached
+				? MatrixCache::global().lu(A)
+				: std::make_shared<const LUDecomposition>(A);
+
+			if (flushedSingular(*lu, A)) return { resultStatus::SINGULAR, 0, 0 };
 
-		for (int i = 0; i < reMat.colCount(); i++) {
-			det *= reMat(i, i);
+			long long exponent;
+			double mantissa = lu->scaledDeterminant(&exponent);
+
+			return { resultStatus::OK, mantissa, exponent };
 		}
 
-		return det * alpha;
+		/**
+		* Determinant as a double, infinite when it is out of the range of doubles.
+		*/
+		double toDouble(const ScaledDeterminant& det) {
+
+			if (det.exponent > std::numeric_limits<int>::max()) return det.mantissa * std::numeric_limits<double>::infinity();
+			if (det.exponent < std::numeric_limits<int>::min()) return det.mantissa * 0.0;
+
+			return std::ldexp(det.mantissa, static_cast<int>(det.exponent));
+		}
+	}
+
+	/**
+	* Calculate the determinant of the matrix, from its LU factorization.
+	* @param A matrix to calculate the determinant of
+	* @return determinant, infinite when it is out of the range of doubles
+	*/
+	double Matrix::determinant(const Matrix A) {
+
+		ALS_PROFILE_SCOPE("Matrix::determinant");
+
+		if (!A.isSquare()) return 0;
+
+		return toDouble(flushedDeterminant(A));
 	}
 
 	/**
@@ -36,51 +106,119 @@ namespace als {
 
 		if (!A.isSquare()) return 0;
 
-		double det = 1;
+		double det = alpha;
+		int exponent = 0;
+		const double* diagonal = A.data();
+		const int n = A.colCount();
 
-		for (int i = 0; i < A.colCount(); i++) {
-			det *= A(i, i);
+		for (int i = 0; i < n; i++) {
+			int e;
+			det = std::frexp(det * diagonal[i * (n + 1)], &e);
+			exponent += e;
 		}
 
-		return det * alpha;
+		return std::ldexp(det, exponent);
 	}
 
 	/**
-	* Check if the matrix in invertible. A matrix is invertible if the determinant is non-zero
+	* Sign and logarithm of the absolute value of the determinant, which
+	* stay representable when the determinant itself overflows.
+	* @param A square matrix
+	*/
+	LogDeterminant Matrix::logDeterminant(const Matrix A) {
+
+		ALS_PROFILE_SCOPE("Matrix::logDeterminant");
+
+		if (!A.isSquare()) return { resultStatus::NOT_SQUARE, 0, std::numeric_limits<double>::quiet_NaN() };
+
+		ScaledDeterminant det = flushedDeterminant(A);
+
+		if (det.status != resultStatus::OK) {
+			return { det.status, 0, -std::numeric_limits<double>::infinity() };
+		}
+
+		return { resultStatus::OK, det.mantissa > 0 ? 1 : -1,
+			std::log(std::abs(det.mantissa)) + det.exponent * std::log(2.0) };
+	}
+
+	/**
+	* Determinant as mantissa * 2^exponent.
+	* @param A square matrix
+	*/
+	ScaledDeterminant Matrix::scaledDeterminant(const Matrix A) {
+
+		ALS_PROFILE_SCOPE("Matrix::scaledDeterminant");
+
+		if (!A.isSquare()) return { resultStatus::NOT_SQUARE, 0, 0 };
+
+		return flushedDeterminant(A);
+	}
+
+	/**
+	* Check if the matrix in invertible. A matrix is invertible if the determinant is non-zero,
+	* numerically if no pivot of its LU factors is under the elimination tolerance,
+	* the same test as invert() and the determinants.
 	*/
 	bool Matrix::isInvertible() const {
-		return Matrix::determinant((*this)) != 0;
+		if (!isSquare()) return false;
+		return !flushedSingular(*MatrixCache::global().lu(*this), *this);
+	}
+
+	/**
+	* Estimate of the 1-norm condition number of the matrix. Large values mean
+	* that solutions lose about log10(condition) digits.
+	* @return estimate, infinity for a singular or non-square matrix
+	*/
+	double Matrix::conditionNumber() const {
+		if (!isSquare()) return std::numeric_limits<double>::infinity();
+		return MatrixCache::global().lu(*this)->conditionEstimate();
 	}
 
 	/**
 	* Calculate the inverse matrix if possible.
 	* @param A matrix to invert
-	* @return (A)^-1
+	* @return (A)^-1, Null(1) if A is not square and Identity if it is singular
 	*/
 	Matrix Matrix::inverse(const Matrix A) {
 
-		if (!A.isSquare()) {
-			std::cout << "ERROR: The matrix to invert is not square. Thus there is no inverse matrix.\n"
-				<< std::endl;
+		InverseResult result = invert(A);
 
-			return Matrix::Null(1);
+		switch (result.status) {
+		case resultStatus::OK: return result.inverse;
+		case resultStatus::NOT_SQUARE: return Matrix::Null(1);
+		default: return Identity(A.rowCount());
 		}
+	}
+
+	/**
+	* Calculate the inverse matrix, reporting why it failed instead of
+	* returning a sentinel.
+	* The columns of the identity are solved with the cached LU factors, or in
+	* mixed precision by refining a single precision LU first.
+	* @param A matrix to invert
+	* @param precision DOUBLE elimination or MIXED precision refinement
+	* @return inverse with the determinant and rank found on the way
+	*/
+	InverseResult Matrix::invert(const Matrix A, solvePrecision precision) {
 
-		Matrix inv = Matrix::Identity(A.rowCount());
+		ALS_PROFILE_SCOPE("Matrix::inverse");
 
-		double alpha = 0;
+		if (!A.isSquare()) {
+			return { resultStatus::NOT_SQUARE, Matrix::Null(1), 0, 0 };
+		}
 
-		Matrix reMat = Matrix::toReducedRowEchelon(A, &inv, &alpha);
+		if (precision == solvePrecision::MIXED) {
+			RefinedSolution refined = solveMixedPrecision(A, Identity(A.rowCount()));
+			if (refined.converged) return { resultStatus::OK, refined.x, refined.determinant, A.rowCount() };
+		}
 
-		double det = Matrix::determinant(reMat, alpha);
+		std::shared_ptr<const LUDecomposition> lu = MatrixCache::global().lu(A);
 
-		if (det == 0) {
-			std::cout << "Warning: the determinant of the matrix is equal to 0. Thus it can't be inverted.\n"
-				<< std::endl;
-			return Identity(A.rowCount());
+		if (flushedSingular(*lu, A)) {
+			return { resultStatus::SINGULAR, Identity(A.rowCount()), 0, A.rank() };
 		}
 
-		return inv;
+		return { resultStatus::OK, lu->solve(Identity(A.rowCount())), lu->determinant(), A.rowCount() };
 	}
 
 	/**
@@ -94,18 +232,17 @@ namespace als {
 
 		Matrix subA = Matrix(A.rowCount() - 1, A.colCount() - 1);
 
-		int index = 0;
+		double* dst = subA.data();
 
 		for (int y = 0; y < A.rowCount(); y++) {
 
 			if (y == j) continue;
 
-			for (int x = 0; x < A.colCount(); x++) {
-				if (x == i) continue;
+			const double* src = A.row(y);
 
-				subA(index) = A(y, x);
-				index++;
-			}
+			// Copy the row in two runs around the removed column
+			dst = std::copy_n(src, i, dst);
+			dst = std::copy(src + i + 1, src + A.colCount(), dst);
 		}
 
 		return subA;
@@ -118,19 +255,23 @@ namespace als {
 	*/
 	Matrix Matrix::adjugate(const Matrix A) {
 
+		ALS_PROFILE_SCOPE("Matrix::adjugate");
+
 		Matrix adjA = Matrix(A.rowCount(), A.colCount());
 
+		// The cofactors are written transposed directly
 		for (int j = 0; j < adjA.rowCount(); j++) {
 			for (int i = 0; i < adjA.colCount(); i++) {
-				adjA(j, i) = A.cofactor(j, i);
+				adjA(i, j) = A.cofactor(j, i);
 			}
 		}
 
-		return adjA.transpose();
+		return adjA;
 	}
 
 	/**
-	* Calculate the j-i-th cofactor of the matrix.
+	* Calculate the j-i-th cofactor of the matrix. The minor is not cached, an
+	* adjugate would otherwise fill the cache with n^2 matrices used once.
 	* @param j row to remove of the matrix
 	* @param i column to remove of the matrix
 	*/
@@ -139,6 +280,8 @@ namespace als {
 
 		Matrix Aji = Matrix::subMatrix((*this), j, i);
 
-		return sign * determinant(Aji);
+		if (!Aji.isSquare()) return 0;
+
+		return sign * toDouble(flushedDeterminant(Aji, false));
 	}
 }
\ No newline at end of file
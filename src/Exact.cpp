@@ -0,0 +1,696 @@
+#include "Exact.h"
+#include "Instrumentation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <utility>
+
+/// <summary>
+/// Implementation of the exact integer backend: a small big integer type,
+/// fraction-free Bareiss elimination and the multi-modular algorithms.
+/// </summary>
+
+namespace als {
+
+	/*** BigInt ***/
+
+	BigInt::BigInt(int64_t value) : _negative(value < 0) {
+
+		// Negating through unsigned keeps INT64_MIN representable
+		uint64_t magnitude = _negative ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+
+		while (magnitude) {
+			_limbs.push_back(static_cast<uint32_t>(magnitude));
+			magnitude >>= 32;
+		}
+	}
+
+	void BigInt::trim() {
+		while (!_limbs.empty() && _limbs.back() == 0) _limbs.pop_back();
+		if (_limbs.empty()) _negative = false;
+	}
+
+	int BigInt::bitLength() const {
+
+		if (isZero()) return 0;
+
+		int bits = 32 * static_cast<int>(_limbs.size() - 1);
+		for (uint32_t top = _limbs.back(); top; top >>= 1) bits++;
+
+		return bits;
+	}
+
+	namespace {
+
+		int compareMagnitude(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b) {
+
+			if (a.size() != b.size()) return a.size() < b.size() ? -1 : 1;
+
+			for (size_t i = a.size(); i-- > 0;) {
+				if (a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+			}
+
+			return 0;
+		}
+
+		std::vector<uint32_t> addMagnitude(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b) {
+
+			const std::vector<uint32_t>& longer = a.size() >= b.size() ? a : b;
+			const std::vector<uint32_t>& shorter = a.size() >= b.size() ? b : a;
+
+			std::vector<uint32_t> sum(longer.size() + 1);
+			uint64_t carry = 0;
+
+			for (size_t i = 0; i < longer.size(); i++) {
+				carry += longer[i];
+				if (i < shorter.size()) carry += shorter[i];
+				sum[i] = static_cast<uint32_t>(carry);
+				carry >>= 32;
+			}
+			sum.back() = static_cast<uint32_t>(carry);
+
+			return sum;
+		}
+
+		/**
+		* a - b for |a| >= |b|.
+		*/
+		std::vector<uint32_t> subMagnitude(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b) {
+
+			std::vector<uint32_t> difference(a.size());
+			int64_t borrow = 0;
+
+			for (size_t i = 0; i < a.size(); i++) {
+				int64_t d = static_cast<int64_t>(a[i]) - borrow - (i < b.size() ? b[i] : 0);
+				borrow = d < 0;
+				difference[i] = static_cast<uint32_t>(d + (borrow << 32));
+			}
+
+			return difference;
+		}
+	}
+
+	BigInt BigInt::operator-() const {
+
+		BigInt negated = *this;
+		if (!isZero()) negated._negative = !_negative;
+
+		return negated;
+	}
+
+	BigInt BigInt::operator+(const BigInt& other) const {
+
+		BigInt sum;
+
+		if (_negative == other._negative) {
+			sum._limbs = addMagnitude(_limbs, other._limbs);
+			sum._negative = _negative;
+		}
+		else if (compareMagnitude(_limbs, other._limbs) >= 0) {
+			sum._limbs = subMagnitude(_limbs, other._limbs);
+			sum._negative = _negative;
+		}
+		else {
+			sum._limbs = subMagnitude(other._limbs, _limbs);
+			sum._negative = other._negative;
+		}
+
+		sum.trim();
+
+		return sum;
+	}
+
+	BigInt BigInt::operator-(const BigInt& other) const {
+		return *this + (-other);
+	}
+
+	BigInt BigInt::mulSmall(uint32_t factor) const {
+
+		BigInt product;
+		product._negative = _negative;
+		product._limbs.resize(_limbs.size() + 1);
+
+		uint64_t carry = 0;
+		for (size_t i = 0; i < _limbs.size(); i++) {
+			carry += static_cast<uint64_t>(_limbs[i]) * factor;
+			product._limbs[i] = static_cast<uint32_t>(carry);
+			carry >>= 32;
+		}
+		product._limbs.back() = static_cast<uint32_t>(carry);
+
+		product.trim();
+
+		return product;
+	}
+
+	/**
+	* Residue of the value in [0, modulus).
+	*/
+	uint32_t BigInt::modSmall(uint32_t modulus) const {
+
+		uint64_t remainder = 0;
+		for (size_t i = _limbs.size(); i-- > 0;) {
+			remainder = ((remainder << 32) | _limbs[i]) % modulus;
+		}
+
+		if (_negative && remainder) remainder = modulus - remainder;
+
+		return static_cast<uint32_t>(remainder);
+	}
+
+	/**
+	* Divide the magnitude in place, truncating toward zero.
+	* @return remainder of the magnitude
+	*/
+	uint32_t BigInt::divSmall(uint32_t divisor) {
+
+		uint64_t remainder = 0;
+		for (size_t i = _limbs.size(); i-- > 0;) {
+			uint64_t current = (remainder << 32) | _limbs[i];
+			_limbs[i] = static_cast<uint32_t>(current / divisor);
+			remainder = current % divisor;
+		}
+
+		trim();
+
+		return static_cast<uint32_t>(remainder);
+	}
+
+	int BigInt::compare(const BigInt& other) const {
+
+		if (_negative != other._negative) return _negative ? -1 : 1;
+
+		int magnitude = compareMagnitude(_limbs, other._limbs);
+
+		return _negative ? -magnitude : magnitude;
+	}
+
+	double BigInt::toDouble() const {
+
+		double value = 0;
+		for (size_t i = _limbs.size(); i-- > 0;) value = value * 4294967296.0 + _limbs[i];
+
+		return _negative ? -value : value;
+	}
+
+	std::string BigInt::toString() const {
+
+		if (isZero()) return "0";
+
+		BigInt rest = *this;
+		std::string digits;
+
+		while (!rest.isZero()) {
+			uint32_t chunk = rest.divSmall(1000000000);
+			for (int d = 0; d < 9; d++) {
+				digits.push_back(static_cast<char>('0' + chunk % 10));
+				chunk /= 10;
+			}
+		}
+
+		while (digits.size() > 1 && digits.back() == '0') digits.pop_back();
+		if (_negative) digits.push_back('-');
+
+		return std::string(digits.rbegin(), digits.rend());
+	}
+
+	std::ostream& operator<<(std::ostream& out, const BigInt& value) {
+		return out << value.toString();
+	}
+
+	/*** Integer matrices ***/
+
+	namespace {
+
+		/**
+		* Checked 64 bit arithmetic.
+		* @return false on overflow
+		*/
+		bool checkedMul(int64_t a, int64_t b, int64_t* result) {
+
+			if (a == 0 || b == 0) {
+				*result = 0;
+				return true;
+			}
+
+			uint64_t ua = a < 0 ? 0 - static_cast<uint64_t>(a) : a;
+			uint64_t ub = b < 0 ? 0 - static_cast<uint64_t>(b) : b;
+			bool negative = (a < 0) != (b < 0);
+			uint64_t limit = static_cast<uint64_t>(std::numeric_limits<int64_t>::max()) + (negative ? 1 : 0);
+
+			if (ub > limit / ua) return false;
+
+			uint64_t product = ua * ub;
+			*result = negative ? static_cast<int64_t>(0 - product) : static_cast<int64_t>(product);
+
+			return true;
+		}
+
+		bool checkedSub(int64_t a, int64_t b, int64_t* result) {
+
+			if ((b > 0 && a < std::numeric_limits<int64_t>::min() + b)
+				|| (b < 0 && a > std::numeric_limits<int64_t>::max() + b)) return false;
+
+			*result = a - b;
+
+			return true;
+		}
+
+		bool checkedAdd(int64_t a, int64_t b, int64_t* result) {
+
+			if ((b > 0 && a > std::numeric_limits<int64_t>::max() - b)
+				|| (b < 0 && a < std::numeric_limits<int64_t>::min() - b)) return false;
+
+			*result = a + b;
+
+			return true;
+		}
+	}
+
+	/**
+	* Copy the matrix if every element is an integer representable in 64 bits.
+	* @return false if an element is not an integer
+	*/
+	bool IntegerMatrix::fromMatrix(const Matrix& A, IntegerMatrix* result) {
+
+		const int count = A.rowCount() * A.colCount();
+		const double* a = A.data();
+
+		result->rows = A.rowCount();
+		result->cols = A.colCount();
+		result->data.resize(count);
+
+		for (int e = 0; e < count; e++) {
+			if (!(std::abs(a[e]) < 9223372036854775808.0) || a[e] != std::trunc(a[e])) return false;
+			result->data[e] = static_cast<int64_t>(a[e]);
+		}
+
+		return true;
+	}
+
+	/**
+	* Exact product.
+	* @return false on overflow or if the sizes don't match
+	*/
+	bool IntegerMatrix::multiply(const IntegerMatrix& B, IntegerMatrix* result) const {
+
+		if (cols != B.rows) return false;
+
+		result->rows = rows;
+		result->cols = B.cols;
+		result->data.assign(static_cast<size_t>(rows) * B.cols, 0);
+
+		for (int j = 0; j < rows; j++) {
+			int64_t* r = result->data.data() + static_cast<size_t>(j) * B.cols;
+			for (int k = 0; k < cols; k++) {
+				const int64_t a = data[static_cast<size_t>(j) * cols + k];
+				if (a == 0) continue;
+				const int64_t* b = B.data.data() + static_cast<size_t>(k) * B.cols;
+				for (int i = 0; i < B.cols; i++) {
+					int64_t term;
+					if (!checkedMul(a, b[i], &term) || !checkedAdd(r[i], term, &r[i])) return false;
+				}
+			}
+		}
+
+		return true;
+	}
+
+	bool IntegerMatrix::isNull() const {
+		return std::all_of(data.begin(), data.end(), [](int64_t e) { return e == 0; });
+	}
+
+	bool IntegerMatrix::operator==(const IntegerMatrix& B) const {
+		return rows == B.rows && cols == B.cols && data == B.data;
+	}
+
+	/*** Modular arithmetic ***/
+
+	namespace {
+
+		uint32_t powMod(uint64_t base, uint64_t exponent, uint32_t p) {
+
+			uint64_t result = 1;
+			base %= p;
+
+			for (; exponent; exponent >>= 1) {
+				if (exponent & 1) result = result * base % p;
+				base = base * base % p;
+			}
+
+			return static_cast<uint32_t>(result);
+		}
+
+		uint32_t invMod(uint32_t a, uint32_t p) {
+			return powMod(a, p - 2, p);
+		}
+
+		/**
+		* Deterministic Miller-Rabin for 32 bit numbers.
+		*/
+		bool isPrime(uint32_t n) {
+
+			if (n < 2) return false;
+			for (uint32_t small : { 2u, 3u, 5u, 7u }) {
+				if (n % small == 0) return n == small;
+			}
+
+			uint32_t d = n - 1;
+			int s = 0;
+			while (!(d & 1)) {
+				d >>= 1;
+				s++;
+			}
+
+			for (uint32_t a : { 2u, 7u, 61u }) {
+
+				if (a % n == 0) continue;
+
+				uint64_t x = powMod(a, d, n);
+				if (x == 1 || x == n - 1) continue;
+
+				bool composite = true;
+				for (int r = 1; r < s && composite; r++) {
+					x = x * x % n;
+					if (x == n - 1) composite = false;
+				}
+
+				if (composite) return false;
+			}
+
+			return true;
+		}
+
+		/**
+		* Primes just below 2^31, so that products of residues fit in 64 bits.
+		*/
+		class PrimeSequence {
+
+			uint32_t _next = 0x7FFFFFFF;
+
+		public:
+
+			uint32_t next() {
+				while (!isPrime(_next)) _next -= 2;
+				uint32_t p = _next;
+				_next -= 2;
+				return p;
+			}
+		};
+
+		/**
+		* Gaussian elimination modulo p of the residues of A (n x n), carrying
+		* the right hand sides of b (n x k) along.
+		* @param x receives A^-1 * b mod p when A is invertible mod p
+		* @return det(A) mod p
+		*/
+		uint32_t eliminateMod(const IntegerMatrix& A, const IntegerMatrix* b, uint32_t p, std::vector<uint32_t>* x) {
+
+			const int n = A.rows;
+			const int k = b ? b->cols : 0;
+			const int width = n + k;
+
+			std::vector<uint32_t> a(static_cast<size_t>(n) * width);
+
+			auto residue = [p](int64_t v) {
+				int64_t r = v % static_cast<int64_t>(p);
+				return static_cast<uint32_t>(r < 0 ? r + p : r);
+			};
+
+			for (int j = 0; j < n; j++) {
+				for (int i = 0; i < n; i++) a[j * width + i] = residue(A.data[static_cast<size_t>(j) * n + i]);
+				for (int c = 0; c < k; c++) a[j * width + n + c] = residue(b->data[static_cast<size_t>(j) * k + c]);
+			}
+
+			uint64_t det = 1;
+
+			for (int s = 0; s < n; s++) {
+
+				int pivot = s;
+				while (pivot < n && a[pivot * width + s] == 0) pivot++;
+				if (pivot == n) return 0;
+
+				if (pivot != s) {
+					std::swap_ranges(a.begin() + pivot * width, a.begin() + (pivot + 1) * width, a.begin() + s * width);
+					det = (p - det) % p;
+				}
+
+				uint32_t* top = a.data() + s * width;
+				det = det * top[s] % p;
+
+				// Normalize the pivot row so the back substitution is free
+				const uint64_t inverse = invMod(top[s], p);
+				for (int i = s; i < width; i++) top[i] = static_cast<uint32_t>(top[i] * inverse % p);
+
+				for (int j = 0; j < n; j++) {
+
+					if (j == s) continue;
+
+					uint32_t* r = a.data() + j * width;
+					const uint64_t factor = r[s];
+					if (factor == 0) continue;
+
+					const uint64_t negated = p - factor;
+					for (int i = s; i < width; i++) r[i] = static_cast<uint32_t>((r[i] + negated * top[i]) % p);
+				}
+			}
+
+			if (x) {
+				x->resize(static_cast<size_t>(n) * k);
+				for (int j = 0; j < n; j++) {
+					for (int c = 0; c < k; c++) (*x)[j * k + c] = a[j * width + n + c];
+				}
+			}
+
+			return static_cast<uint32_t>(det);
+		}
+
+		/**
+		* Incremental Chinese remaindering of values known modulo M,
+		* kept in [0, M) until the symmetric range is requested.
+		*/
+		class CrtAccumulator {
+
+			BigInt _modulus = 1;
+			std::vector<BigInt> _values;
+
+		public:
+
+			explicit CrtAccumulator(size_t count) : _values(count) {}
+
+			void add(const std::vector<uint32_t>& residues, uint32_t p) {
+
+				const uint32_t mInverse = invMod(_modulus.modSmall(p), p);
+
+				for (size_t v = 0; v < _values.size(); v++) {
+					uint64_t difference = (residues[v] + static_cast<uint64_t>(p) - _values[v].modSmall(p)) % p;
+					uint32_t t = static_cast<uint32_t>(difference * mInverse % p);
+					_values[v] = _values[v] + _modulus.mulSmall(t);
+				}
+
+				_modulus = _modulus.mulSmall(p);
+			}
+
+			/**
+			* Representative of smallest magnitude, in (-M / 2, M / 2].
+			*/
+			BigInt symmetric(size_t v) const {
+				return _modulus < _values[v].mulSmall(2) ? _values[v] - _modulus : _values[v];
+			}
+		};
+
+		/**
+		* log2 of a bound on |det(A)| and on the Cramer determinants where one
+		* column of A is replaced by a column of b (Hadamard's inequality).
+		* @return -infinity when A has a zero column
+		*/
+		double hadamardLog2(const IntegerMatrix& A, const IntegerMatrix* b) {
+
+			auto columnNorm2 = [](const IntegerMatrix& M, int i) {
+				double sum = 0;
+				for (int j = 0; j < M.rows; j++) {
+					double v = static_cast<double>(M.data[static_cast<size_t>(j) * M.cols + i]);
+					sum += v * v;
+				}
+				return sum;
+			};
+
+			double bNorm2 = 0;
+			if (b) {
+				for (int c = 0; c < b->cols; c++) bNorm2 = std::max(bNorm2, columnNorm2(*b, c));
+			}
+
+			double bound = 0;
+			for (int i = 0; i < A.cols; i++) {
+				double norm2 = columnNorm2(A, i);
+				if (norm2 == 0) return -std::numeric_limits<double>::infinity();
+				bound += 0.5 * std::log2(std::max(norm2, bNorm2));
+			}
+
+			// Slack for the rounding of the norms
+			return bound * (1 + 1e-12) + 1;
+		}
+	}
+
+	/*** Determinant ***/
+
+	namespace {
+
+		/**
+		* Fraction-free elimination: every intermediate value is itself a minor
+		* of A, so it is an exact integer no larger than the determinant bound.
+		* @return false when a value does not fit in 64 bits
+		*/
+		bool bareissDeterminant(IntegerMatrix a, int64_t* det) {
+
+			const int n = a.rows;
+			int64_t previous = 1;
+			int sign = 1;
+
+			auto at = [&](int j, int i) -> int64_t& { return a.data[static_cast<size_t>(j) * n + i]; };
+
+			for (int k = 0; k < n - 1; k++) {
+
+				if (at(k, k) == 0) {
+
+					int pivot = k + 1;
+					while (pivot < n && at(pivot, k) == 0) pivot++;
+
+					if (pivot == n) {
+						*det = 0;
+						return true;
+					}
+
+					for (int i = 0; i < n; i++) std::swap(at(k, i), at(pivot, i));
+					sign = -sign;
+				}
+
+				const int64_t pivot = at(k, k);
+
+				for (int j = k + 1; j < n; j++) {
+					for (int i = k + 1; i < n; i++) {
+						int64_t left, right, difference;
+						if (!checkedMul(at(j, i), pivot, &left)
+							|| !checkedMul(at(j, k), at(k, i), &right)
+							|| !checkedSub(left, right, &difference)) return false;
+						at(j, i) = difference / previous;
+					}
+				}
+
+				previous = pivot;
+			}
+
+			*det = n == 0 ? 1 : sign * at(n - 1, n - 1);
+
+			return true;
+		}
+
+		BigInt multimodularDeterminant(const IntegerMatrix& A) {
+
+			const double bits = hadamardLog2(A, nullptr);
+			if (bits == -std::numeric_limits<double>::infinity()) return 0;
+
+			CrtAccumulator crt(1);
+			PrimeSequence primes;
+			std::vector<uint32_t> residue(1);
+
+			for (double covered = 0; covered <= bits;) {
+				uint32_t p = primes.next();
+				residue[0] = eliminateMod(A, nullptr, p, nullptr);
+				crt.add(residue, p);
+				covered += std::log2(static_cast<double>(p));
+			}
+
+			return crt.symmetric(0);
+		}
+	}
+
+	/**
+	* Exact determinant of an integer matrix.
+	* @param backend BAREISS works in 64 bits and reports OVERFLOW when the
+	* minors get too large, MULTIMODULAR computes it modulo enough primes to
+	* cover the Hadamard bound, AUTO tries Bareiss on small matrices first
+	*/
+	ExactDeterminant exactDeterminant(const Matrix A, exactBackend backend) {
+
+		ALS_PROFILE_SCOPE("exactDeterminant");
+
+		if (!A.isSquare()) return { resultStatus::NOT_SQUARE, 0 };
+
+		IntegerMatrix a;
+		if (!IntegerMatrix::fromMatrix(A, &a)) return { resultStatus::NOT_INTEGER, 0 };
+
+		ALS_COUNT_FLOPS(2ull * a.rows * a.rows * a.rows / 3);
+
+		if (backend == exactBackend::BAREISS || (backend == exactBackend::AUTO && hadamardLog2(a, nullptr) < 62)) {
+
+			int64_t det;
+			if (bareissDeterminant(a, &det)) return { resultStatus::OK, det };
+			if (backend == exactBackend::BAREISS) return { resultStatus::OVERFLOW, 0 };
+		}
+
+		return { resultStatus::OK, multimodularDeterminant(a) };
+	}
+
+	/*** Solver ***/
+
+	/**
+	* Exact solution of A * x = b for an integer matrix and integer right hand
+	* sides, as det(A)^-1 times the integers adj(A) * b. Each prime gives
+	* det(A) and A^-1 * b modulo p; primes dividing det(A) are skipped, and
+	* when their product exceeds the determinant bound det(A) must be 0.
+	* @param b right hand sides (n x k)
+	*/
+	ExactSolution exactSolve(const Matrix A, const Matrix b) {
+
+		ALS_PROFILE_SCOPE("exactSolve");
+
+		if (!A.isSquare()) return { resultStatus::NOT_SQUARE, {}, 0 };
+		if (b.rowCount() != A.rowCount()) return { resultStatus::SIZE_MISMATCH, {}, 0 };
+
+		IntegerMatrix a, rhs;
+		if (!IntegerMatrix::fromMatrix(A, &a) || !IntegerMatrix::fromMatrix(b, &rhs)) {
+			return { resultStatus::NOT_INTEGER, {}, 0 };
+		}
+
+		const int n = a.rows;
+		const int k = rhs.cols;
+		const double bits = hadamardLog2(a, &rhs);
+
+		if (bits == -std::numeric_limits<double>::infinity()) return { resultStatus::SINGULAR, {}, 0 };
+
+		// Numerators first, the determinant last
+		CrtAccumulator crt(static_cast<size_t>(n) * k + 1);
+		PrimeSequence primes;
+		std::vector<uint32_t> x, residues(static_cast<size_t>(n) * k + 1);
+
+		double covered = 0, unlucky = 0;
+
+		while (covered <= bits) {
+
+			uint32_t p = primes.next();
+			uint32_t det = eliminateMod(a, &rhs, p, &x);
+
+			if (det == 0) {
+				unlucky += std::log2(static_cast<double>(p));
+				if (unlucky > bits) return { resultStatus::SINGULAR, {}, 0 };
+				continue;
+			}
+
+			for (size_t v = 0; v < x.size(); v++) residues[v] = static_cast<uint32_t>(static_cast<uint64_t>(x[v]) * det % p);
+			residues.back() = det;
+
+			crt.add(residues, p);
+			covered += std::log2(static_cast<double>(p));
+		}
+
+		ExactSolution solution = { resultStatus::OK, {}, crt.symmetric(static_cast<size_t>(n) * k) };
+
+		solution.numerators.reserve(static_cast<size_t>(n) * k);
+		for (size_t v = 0; v < static_cast<size_t>(n) * k; v++) solution.numerators.push_back(crt.symmetric(v));
+
+		return solution;
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "Matrix.h"
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace als {
+
+	/**
+	* Arbitrary precision signed integer. Only the operations needed to
+	* rebuild results from their residues are provided.
+	*/
+	class BigInt {
+
+		bool _negative;
+		std::vector<uint32_t> _limbs;	// Little endian magnitude, no leading zero
+
+		void trim();
+
+	public:
+
+		BigInt(int64_t value = 0);
+
+		bool isZero() const { return _limbs.empty(); }
+		bool isNegative() const { return _negative; }
+		int bitLength() const;
+
+		BigInt operator-() const;
+		BigInt operator+(const BigInt& other) const;
+		BigInt operator-(const BigInt& other) const;
+		BigInt mulSmall(uint32_t factor) const;
+		uint32_t modSmall(uint32_t modulus) const;
+		uint32_t divSmall(uint32_t divisor);
+
+		int compare(const BigInt& other) const;
+		bool operator==(const BigInt& other) const { return compare(other) == 0; }
+		bool operator<(const BigInt& other) const { return compare(other) < 0; }
+
+		double toDouble() const;
+		std::string toString() const;
+	};
+
+	std::ostream& operator<<(std::ostream& out, const BigInt& value);
+
+	enum class exactBackend {
+		BAREISS,
+		MULTIMODULAR,
+		AUTO,
+	};
+
+	/**
+	* Integer matrix copied out of a Matrix whose elements are all integers.
+	*/
+	struct IntegerMatrix {
+		int rows;
+		int cols;
+		std::vector<int64_t> data;
+
+		static bool fromMatrix(const Matrix& A, IntegerMatrix* result);
+		bool multiply(const IntegerMatrix& B, IntegerMatrix* result) const;
+		bool isNull() const;
+		bool operator==(const IntegerMatrix& B) const;
+	};
+
+	struct ExactDeterminant {
+		resultStatus status;
+		BigInt value;
+	};
+
+	/**
+	* Solution x = numerators / denominator of an integer system.
+	* The denominator is det(A), the numerators are the Cramer determinants.
+	*/
+	struct ExactSolution {
+		resultStatus status;
+		std::vector<BigInt> numerators;
+		BigInt denominator;
+	};
+
+	ExactDeterminant exactDeterminant(const Matrix A, exactBackend backend = exactBackend::AUTO);
+	ExactSolution exactSolve(const Matrix A, const Matrix b);
+}
@@ -0,0 +1,193 @@
+#include "Instrumentation.h"
+
+/// <summary>
+/// Implementation of the operation registry and of the text/JSON reports.
+/// Only compiled in when ALS_INSTRUMENTATION is defined.
+/// </summary>
+
+#ifdef ALS_INSTRUMENTATION
+
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+
+namespace als::instr {
+
+	namespace {
+
+		std::mutex registryMutex;
+		std::deque<OperationStats> registry;
+
+		thread_local ScopedOperation* currentOperation = nullptr;
+
+		/**
+		* Counters reported outside of any operation land here.
+		*/
+		OperationStats& untracked() {
+			static OperationStats& stats = registerOperation("<untracked>");
+			return stats;
+		}
+
+		OperationStats& target() {
+			return currentOperation ? currentOperation->stats() : untracked();
+		}
+
+		/**
+		* Write a string as a JSON literal.
+		*/
+		void writeJsonString(std::ostream& out, const char* s) {
+			out << '"';
+			for (; *s; s++) {
+				if (*s == '"' || *s == '\\') out << '\\';
+				out << *s;
+			}
+			out << '"';
+		}
+	}
+
+	/**
+	* Find or create the statistics of an operation. Sites registering
+	* the same name share their statistics.
+	* @param name static name of the operation
+	*/
+	OperationStats& registerOperation(const char* name) {
+
+		std::lock_guard<std::mutex> lock(registryMutex);
+
+		for (OperationStats& stats : registry) {
+			if (std::strcmp(stats.name, name) == 0) return stats;
+		}
+
+		OperationStats& stats = registry.emplace_back();
+		stats.name = name;
+
+		return stats;
+	}
+
+	ScopedOperation::ScopedOperation(OperationStats& stats)
+		: _stats(stats), _parent(currentOperation), _start(std::chrono::steady_clock::now()) {
+
+		currentOperation = this;
+	}
+
+	ScopedOperation::~ScopedOperation() {
+
+		auto elapsed = std::chrono::steady_clock::now() - _start;
+
+		_stats.calls.fetch_add(1, std::memory_order_relaxed);
+		_stats.nanoseconds.fetch_add(
+			std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+			std::memory_order_relaxed);
+
+		currentOperation = _parent;
+	}
+
+	void addFlops(uint64_t count) { target().flops.fetch_add(count, std::memory_order_relaxed); }
+	void addBytes(uint64_t count) { target().bytes.fetch_add(count, std::memory_order_relaxed); }
+	void addPivotSwap() { target().pivotSwaps.fetch_add(1, std::memory_order_relaxed); }
+
+	/**
+	* Zero all the counters, keeping the registered operations.
+	*/
+	void reset() {
+
+		std::lock_guard<std::mutex> lock(registryMutex);
+
+		for (OperationStats& stats : registry) {
+			stats.calls = 0;
+			stats.nanoseconds = 0;
+			stats.flops = 0;
+			stats.bytes = 0;
+			stats.pivotSwaps = 0;
+		}
+	}
+
+	/**
+	* Human readable table of the operations that were called.
+	* @param out stream to write to
+	*/
+	void dumpText(std::ostream& out) {
+
+		std::lock_guard<std::mutex> lock(registryMutex);
+
+		out << std::left << std::setw(28) << "operation"
+			<< std::right << std::setw(10) << "calls"
+			<< std::setw(14) << "total ms"
+			<< std::setw(12) << "avg us"
+			<< std::setw(10) << "GFLOP/s"
+			<< std::setw(14) << "bytes"
+			<< std::setw(8) << "swaps" << "\n";
+
+		for (const OperationStats& stats : registry) {
+
+			uint64_t calls = stats.calls.load();
+			uint64_t ns = stats.nanoseconds.load();
+			uint64_t flops = stats.flops.load();
+
+			if (calls == 0 && flops == 0 && stats.bytes.load() == 0) continue;
+
+			out << std::left << std::setw(28) << stats.name
+				<< std::right << std::setw(10) << calls
+				<< std::fixed << std::setprecision(3)
+				<< std::setw(14) << ns / 1e6
+				<< std::setw(12) << (calls ? ns / 1e3 / calls : 0.0)
+				<< std::setw(10) << (ns ? static_cast<double>(flops) / ns : 0.0)
+				<< std::setw(14) << stats.bytes.load()
+				<< std::setw(8) << stats.pivotSwaps.load() << "\n";
+		}
+
+		out << std::defaultfloat << std::flush;
+	}
+
+	/**
+	* Machine readable dump of every registered operation.
+	* @param out stream to write to
+	*/
+	void dumpJson(std::ostream& out) {
+
+		std::lock_guard<std::mutex> lock(registryMutex);
+
+		out << "{\"operations\":[";
+
+		bool first = true;
+
+		for (const OperationStats& stats : registry) {
+
+			if (!first) out << ",";
+			first = false;
+
+			out << "{\"name\":";
+			writeJsonString(out, stats.name);
+			out << ",\"calls\":" << stats.calls.load()
+				<< ",\"nanoseconds\":" << stats.nanoseconds.load()
+				<< ",\"flops\":" << stats.flops.load()
+				<< ",\"bytes\":" << stats.bytes.load()
+				<< ",\"pivotSwaps\":" << stats.pivotSwaps.load() << "}";
+		}
+
+		out << "]}" << std::endl;
+	}
+
+	/**
+	* Print the text report to stderr when the program exits.
+	* If ALS_PROFILE_JSON names a file, the JSON report is written there as well.
+	*/
+	void dumpAtExit() {
+
+		std::atexit([]() {
+			std::cerr << "\n--- Instrumentation ---\n";
+			dumpText(std::cerr);
+
+			if (const char* path = std::getenv("ALS_PROFILE_JSON")) {
+				std::ofstream file(path);
+				if (file) dumpJson(file);
+			}
+		});
+	}
+}
+
+#endif
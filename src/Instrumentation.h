@@ -0,0 +1,84 @@
+#pragma once
+#include <iosfwd>
+#include <cstdint>
+
+/// <summary>
+/// Opt-in instrumentation of the hot routines (call counts, wall time, flops,
+/// bytes allocated and pivot swaps per operation).
+/// Compile with ALS_INSTRUMENTATION defined to enable it. Otherwise every
+/// ALS_* macro below expands to nothing and the layer costs nothing.
+/// </summary>
+
+#ifdef ALS_INSTRUMENTATION
+
+#include <atomic>
+#include <chrono>
+
+namespace als::instr {
+
+	/**
+	* Accumulated statistics of a single named operation.
+	* Time is inclusive of nested operations, flops, bytes and swaps are
+	* attributed to the innermost operation running on the thread.
+	*/
+	struct OperationStats {
+		const char* name = "";
+		std::atomic<uint64_t> calls{ 0 };
+		std::atomic<uint64_t> nanoseconds{ 0 };
+		std::atomic<uint64_t> flops{ 0 };
+		std::atomic<uint64_t> bytes{ 0 };
+		std::atomic<uint64_t> pivotSwaps{ 0 };
+	};
+
+	OperationStats& registerOperation(const char* name);
+
+	/**
+	* RAII timer of an operation. Becomes the target of the counters
+	* for its lifetime on the current thread.
+	*/
+	class ScopedOperation {
+
+		OperationStats& _stats;
+		ScopedOperation* _parent;
+		std::chrono::steady_clock::time_point _start;
+
+	public:
+
+		explicit ScopedOperation(OperationStats& stats);
+		~ScopedOperation();
+		ScopedOperation(const ScopedOperation&) = delete;
+		ScopedOperation& operator=(const ScopedOperation&) = delete;
+
+		OperationStats& stats() { return _stats; }
+	};
+
+	void addFlops(uint64_t count);
+	void addBytes(uint64_t count);
+	void addPivotSwap();
+
+	void reset();
+	void dumpText(std::ostream& out);
+	void dumpJson(std::ostream& out);
+	void dumpAtExit();
+}
+
+#define ALS_INSTR_CONCAT_(a, b) a##b
+#define ALS_INSTR_CONCAT(a, b) ALS_INSTR_CONCAT_(a, b)
+
+#define ALS_PROFILE_SCOPE(name) \
+	static als::instr::OperationStats& ALS_INSTR_CONCAT(_alsStats, __LINE__) = als::instr::registerOperation(name); \
+	als::instr::ScopedOperation ALS_INSTR_CONCAT(_alsScope, __LINE__)(ALS_INSTR_CONCAT(_alsStats, __LINE__))
+#define ALS_COUNT_FLOPS(count) als::instr::addFlops(static_cast<uint64_t>(count))
+#define ALS_COUNT_BYTES(count) als::instr::addBytes(static_cast<uint64_t>(count))
+#define ALS_COUNT_PIVOT() als::instr::addPivotSwap()
+#define ALS_PROFILE_DUMP_AT_EXIT() als::instr::dumpAtExit()
+
+#else
+
+#define ALS_PROFILE_SCOPE(name) ((void)0)
+#define ALS_COUNT_FLOPS(count) ((void)0)
+#define ALS_COUNT_BYTES(count) ((void)0)
+#define ALS_COUNT_PIVOT() ((void)0)
+#define ALS_PROFILE_DUMP_AT_EXIT() ((void)0)
+
+#endif
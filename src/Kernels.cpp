@@ -0,0 +1,395 @@
+#include "Kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <limits>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define ALS_TRANSPOSE_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ALS_TRANSPOSE_SSE2 1
+#endif
+
+/// <summary>
+/// Implementation of the raw storage kernels.
+/// </summary>
+
+namespace als::kernels {
+
+	namespace {
+
+		/**
+		* Transpose a full 4x4 block in registers.
+		*/
+		inline void transpose4x4(const double* src, int lds, double* dst, int ldd) {
+#if defined(ALS_TRANSPOSE_AVX)
+			__m256d r0 = _mm256_loadu_pd(src);
+			__m256d r1 = _mm256_loadu_pd(src + lds);
+			__m256d r2 = _mm256_loadu_pd(src + 2 * lds);
+			__m256d r3 = _mm256_loadu_pd(src + 3 * lds);
+
+			__m256d t0 = _mm256_unpacklo_pd(r0, r1);
+			__m256d t1 = _mm256_unpackhi_pd(r0, r1);
+			__m256d t2 = _mm256_unpacklo_pd(r2, r3);
+			__m256d t3 = _mm256_unpackhi_pd(r2, r3);
+
+			_mm256_storeu_pd(dst, _mm256_permute2f128_pd(t0, t2, 0x20));
+			_mm256_storeu_pd(dst + ldd, _mm256_permute2f128_pd(t1, t3, 0x20));
+			_mm256_storeu_pd(dst + 2 * ldd, _mm256_permute2f128_pd(t0, t2, 0x31));
+			_mm256_storeu_pd(dst + 3 * ldd, _mm256_permute2f128_pd(t1, t3, 0x31));
+#elif defined(ALS_TRANSPOSE_SSE2)
+			// Four 2x2 blocks, each transposed with an unpack pair
+			for (int j = 0; j < 4; j += 2) {
+				for (int i = 0; i < 4; i += 2) {
+					__m128d a = _mm_loadu_pd(src + j * lds + i);
+					__m128d b = _mm_loadu_pd(src + (j + 1) * lds + i);
+					_mm_storeu_pd(dst + i * ldd + j, _mm_unpacklo_pd(a, b));
+					_mm_storeu_pd(dst + (i + 1) * ldd + j, _mm_unpackhi_pd(a, b));
+				}
+			}
+#else
+			for (int j = 0; j < 4; j++) {
+				for (int i = 0; i < 4; i++) {
+					dst[i * ldd + j] = src[j * lds + i];
+				}
+			}
+#endif
+		}
+
+		/**
+		* Transpose a tile of at most transposeTile x transposeTile elements.
+		*/
+		void transposeTileBlock(const double* src, int rows, int cols, int lds, double* dst, int ldd) {
+
+			const int rows4 = rows & ~3;
+			const int cols4 = cols & ~3;
+
+			for (int j = 0; j < rows4; j += 4) {
+				for (int i = 0; i < cols4; i += 4) {
+					transpose4x4(src + j * lds + i, lds, dst + i * ldd + j, ldd);
+				}
+				for (int i = cols4; i < cols; i++) {
+					for (int jj = j; jj < j + 4; jj++) {
+						dst[i * ldd + jj] = src[jj * lds + i];
+					}
+				}
+			}
+
+			for (int j = rows4; j < rows; j++) {
+				for (int i = 0; i < cols; i++) {
+					dst[i * ldd + j] = src[j * lds + i];
+				}
+			}
+		}
+	}
+
+	/**
+	* Out of place blocked transposition. Tiles are read and written
+	* whole so both sides stream through the cache instead of missing on
+	* every column strided write.
+	* @param src rows x cols matrix
+	* @param dst cols x rows matrix, must not overlap src
+	*/
+	void transpose(const double* src, int rows, int cols, int lds, double* dst, int ldd) {
+
+		for (int jj = 0; jj < rows; jj += transposeTile) {
+
+			const int tileRows = std::min(transposeTile, rows - jj);
+
+			for (int ii = 0; ii < cols; ii += transposeTile) {
+
+				const int tileCols = std::min(transposeTile, cols - ii);
+
+				transposeTileBlock(src + jj * lds + ii, tileRows, tileCols, lds,
+					dst + ii * ldd + jj, ldd);
+			}
+		}
+	}
+
+	/**
+	* In place transposition of a square matrix. The tiles above the
+	* diagonal are swapped with their mirror, both staying in cache.
+	* @param a n x n matrix
+	*/
+	void transposeInPlace(double* a, int n, int lda) {
+
+		for (int jj = 0; jj < n; jj += transposeTile) {
+
+			const int jEnd = std::min(jj + transposeTile, n);
+
+			// Diagonal tile
+			for (int j = jj; j < jEnd; j++) {
+				for (int i = j + 1; i < jEnd; i++) {
+					std::swap(a[j * lda + i], a[i * lda + j]);
+				}
+			}
+
+			// Tile pairs (jj, ii) and (ii, jj)
+			for (int ii = jEnd; ii < n; ii += transposeTile) {
+
+				const int iEnd = std::min(ii + transposeTile, n);
+
+				for (int j = jj; j < jEnd; j++) {
+					for (int i = ii; i < iEnd; i++) {
+						std::swap(a[j * lda + i], a[i * lda + j]);
+					}
+				}
+			}
+		}
+	}
+
+	/**
+	* In place LU factorization with partial pivoting.
+	* @param a n x n matrix, replaced by L (unit diagonal, below) and U
+	* @param pivots n row interchanges
+	* @return false if a pivot is zero or not finite
+	*/
+	template <typename T>
+	bool luFactor(T* a, int n, int lda, int* pivots) {
+
+		for (int k = 0; k < n; k++) {
+
+			int p = k;
+			for (int j = k + 1; j < n; j++) {
+				if (std::abs(a[j * lda + k]) > std::abs(a[p * lda + k])) p = j;
+			}
+
+			pivots[k] = p;
+
+			if (p != k) std::swap_ranges(a + k * lda, a + k * lda + n, a + p * lda);
+
+			const T pivot = a[k * lda + k];
+			if (pivot == T(0) || !std::isfinite(pivot)) return false;
+
+			const T* pivotRow = a + k * lda;
+
+			for (int j = k + 1; j < n; j++) {
+
+				T* r = a + j * lda;
+				const T l = r[k] / pivot;
+				r[k] = l;
+
+				for (int i = k + 1; i < n; i++) {
+					r[i] -= l * pivotRow[i];
+				}
+			}
+		}
+
+		return true;
+	}
+
+	/**
+	* Solve A * x = b in place from the factors of luFactor.
+	* @param x n x k right hand sides, replaced by the solutions
+	*/
+	template <typename T>
+	void luSolve(const T* lu, int n, int lda, const int* pivots, T* x, int k, int ldx) {
+
+		for (int i = 0; i < n; i++) {
+			if (pivots[i] != i) std::swap_ranges(x + i * ldx, x + i * ldx + k, x + pivots[i] * ldx);
+		}
+
+		for (int i = 0; i < n; i++) {
+			T* xi = x + i * ldx;
+			for (int j = 0; j < i; j++) {
+				const T l = lu[i * lda + j];
+				const T* xj = x + j * ldx;
+				for (int c = 0; c < k; c++) xi[c] -= l * xj[c];
+			}
+		}
+
+		for (int i = n - 1; i >= 0; i--) {
+			T* xi = x + i * ldx;
+			for (int j = i + 1; j < n; j++) {
+				const T u = lu[i * lda + j];
+				const T* xj = x + j * ldx;
+				for (int c = 0; c < k; c++) xi[c] -= u * xj[c];
+			}
+			const T diagonal = lu[i * lda + i];
+			for (int c = 0; c < k; c++) xi[c] /= diagonal;
+		}
+	}
+
+	/**
+	* Blocked product. Slices of B are reused by four rows of C at a time,
+	* which keeps four accumulating rows and one row of B in flight.
+	*/
+	void gemm(int m, int n, int k, const double* a, int lda, const double* b, int ldb,
+		double* c, int ldc, bool accumulate) {
+
+		if (!accumulate) {
+			for (int j = 0; j < m; j++) std::fill_n(c + j * ldc, n, 0.0);
+		}
+
+		for (int kk = 0; kk < k; kk += gemmBlockK) {
+
+			const int kEnd = std::min(kk + gemmBlockK, k);
+
+			for (int ii = 0; ii < n; ii += gemmBlockN) {
+
+				const int width = std::min(gemmBlockN, n - ii);
+				int j = 0;
+
+				for (; j + 4 <= m; j += 4) {
+
+					double* c0 = c + j * ldc + ii;
+					double* c1 = c0 + ldc;
+					double* c2 = c1 + ldc;
+					double* c3 = c2 + ldc;
+					const double* aj = a + j * lda;
+
+					for (int x = kk; x < kEnd; x++) {
+						const double a0 = aj[x], a1 = aj[lda + x], a2 = aj[2 * lda + x], a3 = aj[3 * lda + x];
+						const double* bx = b + x * ldb + ii;
+						for (int i = 0; i < width; i++) {
+							const double bi = bx[i];
+							c0[i] += a0 * bi;
+							c1[i] += a1 * bi;
+							c2[i] += a2 * bi;
+							c3[i] += a3 * bi;
+						}
+					}
+				}
+
+				for (; j < m; j++) {
+					double* cj = c + j * ldc + ii;
+					for (int x = kk; x < kEnd; x++) {
+						const double ax = a[j * lda + x];
+						const double* bx = b + x * ldb + ii;
+						for (int i = 0; i < width; i++) cj[i] += ax * bx[i];
+					}
+				}
+			}
+		}
+	}
+
+	void parallelChunks(int count, const std::function<void(int)>& work) {
+
+		const int workers = std::min<int>(count, std::max(1u, std::thread::hardware_concurrency()));
+
+		if (workers <= 1) {
+			for (int c = 0; c < count; c++) work(c);
+			return;
+		}
+
+		std::vector<std::future<void>> pending;
+		for (int w = 1; w < workers; w++) {
+			pending.push_back(std::async(std::launch::async, [&work, w, workers, count]() {
+				for (int c = w; c < count; c += workers) work(c);
+			}));
+		}
+		for (int c = 0; c < count; c += workers) work(c);
+
+		for (std::future<void>& f : pending) f.get();
+	}
+
+	/**
+	* Four independent accumulators, so that the additions pipeline and
+	* vectorize instead of waiting on each other.
+	*/
+	double dot(int n, const double* x, const double* y) {
+
+		double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+		int i = 0;
+
+		for (; i + 4 <= n; i += 4) {
+			s0 += x[i] * y[i];
+			s1 += x[i + 1] * y[i + 1];
+			s2 += x[i + 2] * y[i + 2];
+			s3 += x[i + 3] * y[i + 3];
+		}
+		for (; i < n; i++) s0 += x[i] * y[i];
+
+		return (s0 + s1) + (s2 + s3);
+	}
+
+	void axpy(int n, double alpha, const double* x, double* y) {
+		if (alpha == 0) return;
+		for (int i = 0; i < n; i++) y[i] += alpha * x[i];
+	}
+
+	void scal(int n, double alpha, double* x) {
+		for (int i = 0; i < n; i++) x[i] *= alpha;
+	}
+
+	double nrm2(int n, const double* x) {
+
+		const double squares = dot(n, x, x);
+
+		if (std::isfinite(squares) && squares >= std::numeric_limits<double>::min() / std::numeric_limits<double>::epsilon()) {
+			return std::sqrt(squares);
+		}
+
+		double scale = 0;
+		for (int i = 0; i < n; i++) scale = std::max(scale, std::abs(x[i]));
+		if (scale == 0 || !std::isfinite(scale)) return scale;
+
+		double scaled = 0;
+		for (int i = 0; i < n; i++) scaled += (x[i] / scale) * (x[i] / scale);
+
+		return scale * std::sqrt(scaled);
+	}
+
+	/**
+	* Row by row dot products, the rows split across threads for the large
+	* matrices. Every element of y comes from a single thread.
+	*/
+	void gemv(int m, int n, double alpha, const double* a, int lda, const double* x, double beta, double* y) {
+
+		auto rows = [=](int first, int last) {
+			for (int j = first; j < last; j++) {
+				const double ax = alpha * dot(n, a + static_cast<size_t>(j) * lda, x);
+				y[j] = beta == 0 ? ax : ax + beta * y[j];
+			}
+		};
+
+		if (static_cast<long long>(m) * n < gemvParallelThreshold) {
+			rows(0, m);
+			return;
+		}
+
+		const int chunkRows = std::max(1, gemvGrain / std::max(1, n));
+		parallelChunks((m + chunkRows - 1) / chunkRows, [&](int c) {
+			rows(c * chunkRows, std::min(m, (c + 1) * chunkRows));
+		});
+	}
+
+	/**
+	* Rows of A scaled into y, so that the access stays unit stride. The
+	* columns are split across threads for the large matrices, each thread
+	* owning a slice of y.
+	*/
+	void gemvTransposed(int m, int n, double alpha, const double* a, int lda, const double* x, double beta, double* y) {
+
+		auto columns = [=](int first, int last) {
+			if (beta == 0) std::fill(y + first, y + last, 0.0);
+			else if (beta != 1) scal(last - first, beta, y + first);
+			for (int j = 0; j < m; j++) {
+				axpy(last - first, alpha * x[j], a + static_cast<size_t>(j) * lda + first, y + first);
+			}
+		};
+
+		if (static_cast<long long>(m) * n < gemvParallelThreshold) {
+			columns(0, n);
+			return;
+		}
+
+		// Slices of whole cache lines, at least as many as the threads
+		const int threads = std::max(1u, std::thread::hardware_concurrency());
+		const int width = std::max(8, (n / threads + 7) / 8 * 8);
+		parallelChunks((n + width - 1) / width, [&](int c) {
+			columns(c * width, std::min(n, (c + 1) * width));
+		});
+	}
+
+	template bool luFactor<float>(float*, int, int, int*);
+	template bool luFactor<double>(double*, int, int, int*);
+	template void luSolve<float>(const float*, int, int, const int*, float*, int, int);
+	template void luSolve<double>(const double*, int, int, const int*, double*, int, int);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <functional>
+
+/// <summary>
+/// Low level kernels working on raw row major storage.
+/// Leading dimensions (ld*) are the distances between two consecutive rows.
+/// </summary>
+
+namespace als::kernels {
+
+	/// Side of the square tiles moved at once by the blocked transpositions.
+	/// Two tiles of doubles stay well within L1.
+	constexpr int transposeTile = 32;
+
+	void transpose(const double* src, int rows, int cols, int lds, double* dst, int ldd);
+	void transposeInPlace(double* a, int n, int lda);
+
+	/// Depth of the slices of the inner dimension and width of the slices of
+	/// the columns of C in the blocked product, sized for a slice of B in L2.
+	constexpr int gemmBlockK = 128;
+	constexpr int gemmBlockN = 256;
+
+	/// Smallest dimension from which a Strassen-Winograd level beats the
+	/// blocked product, measured with --bench.
+	constexpr int strassenCrossover = 128;
+
+	/// C = A * B, or C += A * B when accumulating. A is m x k, B is k x n.
+	void gemm(int m, int n, int k, const double* a, int lda, const double* b, int ldb,
+		double* c, int ldc, bool accumulate = false);
+
+	/// C = A * B by Strassen-Winograd recursion down to the blocked product.
+	/// @param crossover smallest dimension still split, 0 for strassenCrossover
+	void strassen(int m, int n, int k, const double* a, int lda, const double* b, int ldb,
+		double* c, int ldc, int crossover = 0);
+
+	/// Number of matrix elements from which a matrix-vector product is
+	/// split across threads, and elements handled by one of its chunks.
+	constexpr int gemvParallelThreshold = 1 << 17;
+	constexpr int gemvGrain = 1 << 15;
+
+	/// Run work(c) for every chunk c in [0, count), spread over the hardware threads.
+	void parallelChunks(int count, const std::function<void(int)>& work);
+
+	/// x^T * y
+	double dot(int n, const double* x, const double* y);
+	/// y += alpha * x
+	void axpy(int n, double alpha, const double* x, double* y);
+	/// x *= alpha
+	void scal(int n, double alpha, double* x);
+	/// Euclidean norm, rescaled when the squares over or underflow
+	double nrm2(int n, const double* x);
+
+	/// y = alpha * A * x + beta * y. A is m x n, y is not read when beta is 0.
+	void gemv(int m, int n, double alpha, const double* a, int lda, const double* x, double beta, double* y);
+	/// y = alpha * A^T * x + beta * y. A is m x n, y is not read when beta is 0.
+	void gemvTransposed(int m, int n, double alpha, const double* a, int lda, const double* x, double beta, double* y);
+
+	/// LU factorization with partial pivoting, instantiated for float and double.
+	/// pivots[k] is the row swapped with row k at step k (LAPACK convention).
+	template <typename T>
+	bool luFactor(T* a, int n, int lda, int* pivots);
+
+	template <typename T>
+	void luSolve(const T* lu, int n, int lda, const int* pivots, T* x, int k, int ldx);
+}
@@ -0,0 +1,363 @@
+#include "LU.h"
+#include "Instrumentation.h"
+#include "Reductions.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+/// <summary>
+/// Implementation of the pivoted LU factorization.
+/// </summary>
+
+namespace als {
+
+	namespace {
+
+		/**
+		* Find the pivot of step k according to the strategy.
+		* @return row and column of the pivot
+		*/
+		std::pair<int, int> findPivot(const Matrix& a, int k, pivotStrategy pivoting) {
+
+			const int n = a.rowCount();
+
+			auto columnMax = [&](int i) {
+				int best = k;
+				for (int r = k + 1; r < n; r++) {
+					if (std::abs(a(r, i)) > std::abs(a(best, i))) best = r;
+				}
+				return best;
+			};
+
+			auto rowMax = [&](int j) {
+				const double* r = a.row(j);
+				int best = k;
+				for (int i = k + 1; i < n; i++) {
+					if (std::abs(r[i]) > std::abs(r[best])) best = i;
+				}
+				return best;
+			};
+
+			switch (pivoting) {
+			case pivotStrategy::NONE:
+				return { k, k };
+
+			case pivotStrategy::PARTIAL:
+				return { columnMax(k), k };
+
+			case pivotStrategy::ROOK: {
+				// Alternate column and row searches until the element
+				// is the largest of both its row and its column
+				int j = columnMax(k);
+				int i = k;
+
+				while (true) {
+					int iBest = rowMax(j);
+					if (std::abs(a(j, iBest)) <= std::abs(a(j, i))) break;
+					i = iBest;
+
+					int jBest = columnMax(i);
+					if (std::abs(a(jBest, i)) <= std::abs(a(j, i))) break;
+					j = jBest;
+				}
+
+				return { j, i };
+			}
+
+			case pivotStrategy::COMPLETE: {
+				int bestJ = k, bestI = k;
+				for (int j = k; j < n; j++) {
+					const double* r = a.row(j);
+					for (int i = k; i < n; i++) {
+						if (std::abs(r[i]) > std::abs(a(bestJ, bestI))) {
+							bestJ = j;
+							bestI = i;
+						}
+					}
+				}
+				return { bestJ, bestI };
+			}
+			}
+
+			return { k, k };
+		}
+	}
+
+	/**
+	* Factor the matrix. A zero pivot leaves its column uneliminated,
+	* which makes the decomposition singular.
+	* @param A square matrix to factor
+	* @param pivoting strategy used to choose the pivots
+	*/
+	LUDecomposition::LUDecomposition(const Matrix A, pivotStrategy pivoting)
+		: _LU(A.rowCount(), A.colCount()), _sign(1), _norm1(0) {
+
+		ALS_PROFILE_SCOPE("LUDecomposition");
+
+		if (!A.isSquare()) {
+			std::cerr << "ERROR: The matrix is not square, it has no LU decomposition.\n" << std::endl;
+			_LU = Matrix::Null(1);
+			_rowPerm = _colPerm = { 0 };
+			return;
+		}
+
+		const int n = A.rowCount();
+
+		_LU.fill(A.data());
+		_rowPerm.resize(n);
+		_colPerm.resize(n);
+
+		for (int i = 0; i < n; i++) _rowPerm[i] = _colPerm[i] = i;
+
+		_norm1 = reductions::norm1(A);
+
+		for (int k = 0; k < n; k++) {
+
+			auto [pj, pi] = findPivot(_LU, k, pivoting);
+
+			if (pj != k) {
+				_LU.swapEquations(k, pj);
+				std::swap(_rowPerm[k], _rowPerm[pj]);
+				_sign = -_sign;
+			}
+			if (pi != k) {
+				for (int j = 0; j < n; j++) std::swap(_LU(j, k), _LU(j, pi));
+				std::swap(_colPerm[k], _colPerm[pi]);
+				_sign = -_sign;
+			}
+
+			const double pivot = _LU(k, k);
+			if (pivot == 0) continue;
+
+			const double* pivotRow = _LU.row(k);
+
+			ALS_COUNT_FLOPS(2ull * (n - k - 1) * (n - k - 1));
+
+			for (int j = k + 1; j < n; j++) {
+
+				double* r = _LU.row(j);
+				const double l = r[k] / pivot;
+				r[k] = l;
+
+				for (int i = k + 1; i < n; i++) {
+					r[i] -= l * pivotRow[i];
+				}
+			}
+		}
+	}
+
+	/**
+	* Check if a pivot is exactly zero or if the matrix is
+	* too ill-conditioned for a double precision answer.
+	*/
+	bool LUDecomposition::isSingular() const {
+		return !(conditionEstimate() * std::numeric_limits<double>::epsilon() < 1);
+	}
+
+	/**
+	* Determinant of the factored matrix. Infinite or zero only when
+	* the determinant itself is out of the range of doubles.
+	*/
+	double LUDecomposition::determinant() const {
+
+		long long exponent;
+		double mantissa = scaledDeterminant(&exponent);
+
+		if (exponent > std::numeric_limits<int>::max()) return mantissa * std::numeric_limits<double>::infinity();
+		if (exponent < std::numeric_limits<int>::min()) return mantissa * 0.0;
+
+		return std::ldexp(mantissa, static_cast<int>(exponent));
+	}
+
+	/**
+	* Determinant as mantissa * 2^exponent, which can't overflow or underflow.
+	* The product of the pivots is renormalized after every factor.
+	* @param exponent receives the power of two
+	* @return mantissa, 0 or of magnitude in [0.5, 1)
+	*/
+	double LUDecomposition::scaledDeterminant(long long* exponent) const {
+
+		double mantissa = _sign;
+		*exponent = 0;
+
+		for (int i = 0; i < size(); i++) {
+
+			int e;
+			mantissa = std::frexp(mantissa * _LU(i, i), &e);
+			*exponent += e;
+
+			if (mantissa == 0) {
+				*exponent = 0;
+				break;
+			}
+		}
+
+		return mantissa;
+	}
+
+	/**
+	* Logarithm of the absolute value of the determinant, the sum of
+	* log|u_ii|, which stays finite for any regular matrix.
+	* @param sign receives -1, 0 or 1
+	* @return log|det|, -infinity for a singular matrix
+	*/
+	double LUDecomposition::logDeterminant(int* sign) const {
+
+		long long exponent;
+		double mantissa = scaledDeterminant(&exponent);
+
+		*sign = (mantissa > 0) - (mantissa < 0);
+		if (mantissa == 0) return -std::numeric_limits<double>::infinity();
+
+		return std::log(std::abs(mantissa)) + exponent * std::log(2.0);
+	}
+
+	/**
+	* Solve A * x = b for every column of b.
+	* @param b right hand sides (n x k)
+	* @return x (n x k)
+	*/
+	Matrix LUDecomposition::solve(const Matrix b) const {
+
+		const int n = size();
+		const int k = b.colCount();
+
+		Matrix y(n, k);
+
+		for (int i = 0; i < n; i++) {
+			std::copy_n(b.row(_rowPerm[i]), k, y.row(i));
+		}
+
+		// L * z = P * b
+		for (int i = 0; i < n; i++) {
+			double* yi = y.row(i);
+			const double* l = _LU.row(i);
+			for (int j = 0; j < i; j++) {
+				const double* yj = y.row(j);
+				for (int c = 0; c < k; c++) yi[c] -= l[j] * yj[c];
+			}
+		}
+
+		// U * (Q^T * x) = z
+		for (int i = n - 1; i >= 0; i--) {
+			double* yi = y.row(i);
+			const double* u = _LU.row(i);
+			for (int j = i + 1; j < n; j++) {
+				const double* yj = y.row(j);
+				for (int c = 0; c < k; c++) yi[c] -= u[j] * yj[c];
+			}
+			for (int c = 0; c < k; c++) yi[c] /= u[i];
+		}
+
+		Matrix x(n, k);
+
+		for (int i = 0; i < n; i++) {
+			std::copy_n(y.row(i), k, x.row(_colPerm[i]));
+		}
+
+		return x;
+	}
+
+	/**
+	* Solve A^T * x = b for every column of b.
+	* @param b right hand sides (n x k)
+	* @return x (n x k)
+	*/
+	Matrix LUDecomposition::solveTransposed(const Matrix b) const {
+
+		const int n = size();
+		const int k = b.colCount();
+
+		Matrix s(n, k);
+
+		for (int i = 0; i < n; i++) {
+			std::copy_n(b.row(_colPerm[i]), k, s.row(i));
+		}
+
+		// U^T * w = Q^T * b
+		for (int i = 0; i < n; i++) {
+			double* si = s.row(i);
+			const double* u = _LU.row(i);
+			for (int c = 0; c < k; c++) si[c] /= u[i];
+			for (int j = i + 1; j < n; j++) {
+				double* sj = s.row(j);
+				for (int c = 0; c < k; c++) sj[c] -= u[j] * si[c];
+			}
+		}
+
+		// L^T * (P * x) = w
+		for (int i = n - 1; i >= 0; i--) {
+			const double* si = s.row(i);
+			const double* l = _LU.row(i);
+			for (int j = 0; j < i; j++) {
+				double* sj = s.row(j);
+				for (int c = 0; c < k; c++) sj[c] -= l[j] * si[c];
+			}
+		}
+
+		Matrix x(n, k);
+
+		for (int i = 0; i < n; i++) {
+			std::copy_n(s.row(i), k, x.row(_rowPerm[i]));
+		}
+
+		return x;
+	}
+
+	/**
+	* Estimate the 1-norm condition number ||A|| * ||A^-1|| without
+	* forming the inverse (Hager's method with Higham's refinements).
+	* O(n^2) once the factorization exists.
+	* @return estimate, infinity for an exactly singular matrix
+	*/
+	double LUDecomposition::conditionEstimate() const {
+
+		const int n = size();
+
+		for (int i = 0; i < n; i++) {
+			if (_LU(i, i) == 0) return std::numeric_limits<double>::infinity();
+		}
+
+		Matrix x(n, 1);
+		for (int i = 0; i < n; i++) x(i) = 1.0 / n;
+
+		double estimate = 0;
+
+		for (int iteration = 0; iteration < 5; iteration++) {
+
+			Matrix y = solve(x);
+			double yNorm = reductions::norm1(y);
+
+			if (iteration > 0 && yNorm <= estimate) break;
+			estimate = yNorm;
+
+			Matrix xi(n, 1);
+			for (int i = 0; i < n; i++) xi(i) = y(i) >= 0 ? 1 : -1;
+
+			Matrix z = solveTransposed(xi);
+
+			int jMax = 0;
+			double zx = 0;
+			for (int i = 0; i < n; i++) {
+				if (std::abs(z(i)) > std::abs(z(jMax))) jMax = i;
+				zx += z(i) * x(i);
+			}
+
+			if (iteration > 0 && std::abs(z(jMax)) <= zx) break;
+
+			for (int i = 0; i < n; i++) x(i) = 0;
+			x(jMax) = 1;
+		}
+
+		// Alternating vector guarding against the worst cases of the iteration
+		Matrix alt(n, 1);
+		for (int i = 0; i < n; i++) {
+			alt(i) = ((i % 2) ? -1 : 1) * (1 + (n > 1 ? double(i) / (n - 1) : 0));
+		}
+		estimate = std::max(estimate, 2 * reductions::norm1(solve(alt)) / (3 * n));
+
+		return _norm1 * estimate;
+	}
+}
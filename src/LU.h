@@ -0,0 +1,46 @@
+#pragma once
+#include "Matrix.h"
+
+#include <vector>
+
+namespace als {
+
+	enum class pivotStrategy {
+		NONE,
+		PARTIAL,
+		ROOK,
+		COMPLETE,
+	};
+
+	/**
+	* Pivoted LU factorization P * A * Q = L * U of a square matrix.
+	* L has a unit diagonal and is stored with U in a single matrix.
+	*/
+	class LUDecomposition {
+
+		Matrix _LU;
+		std::vector<int> _rowPerm, _colPerm;
+		int _sign;
+		double _norm1;
+
+	public:
+
+		LUDecomposition(const Matrix A, pivotStrategy pivoting = pivotStrategy::PARTIAL);
+
+		int size() const { return _LU.rowCount(); }
+		const Matrix& packed() const { return _LU; }
+		const std::vector<int>& rowPermutation() const { return _rowPerm; }
+		const std::vector<int>& colPermutation() const { return _colPerm; }
+		int permutationSign() const { return _sign; }
+
+		bool isSingular() const;
+		double determinant() const;
+		double scaledDeterminant(long long* exponent) const;
+		double logDeterminant(int* sign) const;
+
+		Matrix solve(const Matrix b) const;
+		Matrix solveTransposed(const Matrix b) const;
+
+		double conditionEstimate() const;
+	};
+}
@@ -1,4 +1,11 @@
 #include "Matrix.h"
+#include "Instrumentation.h"
+#include "Kernels.h"
+#include "Reductions.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
 
 /// <summary>
 /// Implementation of the basic matrix operations.
@@ -14,6 +21,7 @@ namespace als {
 	Matrix::Matrix(int m, int n) : _m(m), _n(n) {
 
 		_A = std::shared_ptr<double[]>(new double[_m * _n]);
+		ALS_COUNT_BYTES(sizeof(double) * _m * _n);
 	}
 
 	/**
@@ -38,9 +46,7 @@ namespace als {
 	Matrix Matrix::Null(int dim) {
 		Matrix O(dim, dim);
 
-		for (int a = 0; a < dim * dim; a++) {
-			O(a) = 0;
-		}
+		std::fill_n(O.data(), dim * dim, 0.0);
 
 		return O;
 	}
@@ -51,11 +57,36 @@ namespace als {
 	*
 	* @param data to put in the matrix
 	*/
-	void Matrix::fill(double* B) {
+	void Matrix::fill(const double* B) {
 
-		for (int a = 0; a < _m * _n; a++) {
-			_A.get()[a] = B[a];
-		}
+		detach(false);
+		std::copy_n(B, _m * _n, _A.get());
+	}
+
+	/**
+	* Replace the shared storage by a private one.
+	* @param keepContents copy the elements, otherwise they are left undefined
+	*/
+	void Matrix::copyStorage(bool keepContents) {
+
+		std::shared_ptr<double[]> storage(new double[_m * _n]);
+		ALS_COUNT_BYTES(sizeof(double) * _m * _n);
+
+		if (keepContents) std::copy_n(_A.get(), _m * _n, storage.get());
+
+		_A = std::move(storage);
+	}
+
+	/**
+	* Copy of the matrix that does not share its storage, made right away
+	* instead of on the first write.
+	*/
+	Matrix Matrix::clone() const {
+
+		Matrix copy(_m, _n);
+		copy.fill(data());
+
+		return copy;
 	}
 
 	/**
@@ -75,43 +106,30 @@ namespace als {
 	}
 
 	/**
-	* Rank of the matrix. Number of non-null rows.
+	* Numerical rank of the matrix, from a QR decomposition with column pivoting.
+	* @param tolerance magnitude under which a diagonal element of R is null,
+	* negative for max(m, n) * eps * |R(0, 0)|
 	*/
-	int Matrix::rank() const {
-
-		int rank = 0;
-
-		for (int j = 0; j < _m; j++) {
-
-			double absSum = 0;
-
-			for (int i = 0; i < _n; i++) {
-				absSum += abs((*this)(j, i));
-			}
-
-			if (absSum != 0) rank++;
-		}
-
-		return rank;
+	int Matrix::rank(double tolerance) const {
+		return reductions::rank(*this, tolerance);
 	}
 
 	/**
 	* Trace of the matrix. Sum of the diagonal of a square matrix.
+	* @return trace, 0 if the matrix is not square
 	*/
 	double Matrix::trace() const {
+		return tryTrace().value;
+	}
 
-		if (!isSquare()) {
-			std::cerr << "ERROR: The matrix is not square, the trace is not defined. \n" << std::endl;
-			return 0;
-		}
-
-		double trace = 0;
+	/**
+	* Trace of the matrix, with a status instead of a sentinel value.
+	*/
+	ScalarResult Matrix::tryTrace() const {
 
-		for (int i = 0; i < _m; i++) {
-			trace += (*this)(i, i);
-		}
+		if (!isSquare()) return { resultStatus::NOT_SQUARE, 0 };
 
-		return trace;
+		return { resultStatus::OK, reductions::trace(*this) };
 	}
 
 	/**
@@ -119,90 +137,57 @@ namespace als {
 	*/
 	Matrix Matrix::transpose() const {
 
+		ALS_PROFILE_SCOPE("Matrix::transpose");
+
 		Matrix res(_n, _m);
+		kernels::transpose(data(), _m, _n, _n, res.data(), _m);
 
-		for (int j = 0; j < _m; j++) {
-			for (int i = 0; i < _n; i++) {
-				res(i, j) = (*this)(j, i);
-			}
-		}
 		return res;
 	}
 
 	/**
-	* Get the element from the matrix.
-	* @param linear position (a)
+	* Transpose the matrix without allocating when it is square.
 	*/
-	double Matrix::operator()(int a) const {
-		if (a > _m * _n) {
-			std::cerr << "ERROR: the element requested is outside of the matrix.\n";
-			return 0;
-		}
+	void Matrix::transposeInPlace() {
 
-		return _A[a];
-	}
+		ALS_PROFILE_SCOPE("Matrix::transposeInPlace");
 
-	/**
-	* Get the element from the matrix.
-	* @param linear position (a)
-	*/
-	double& Matrix::operator()(int a) {
-		if (a > _m * _n) {
-			std::cerr << "FATAL ERROR: the element requested is outside of the matrix.\n";
-			exit(-1);
+		if (isSquare()) {
+			kernels::transposeInPlace(data(), _n, _n);
 		}
-
-		return _A[a];
-	}
-
-	/**
-	* Get the element from the matrix.
-	* @param row (j)
-	* @param column (i)
-	*/
-	double Matrix::operator()(int j, int i) const {
-		if (j > _m || i > _n) {
-			std::cerr << "ERROR: the element requested is outside of the matrix.\n";
-			return 0;
+		else {
+			*this = transpose();
 		}
-
-		return _A[j * _n + i];
 	}
 
 	/**
-	* Get the element from the matrix.
+	* Report an access outside of the matrix. Only reachable from the
+	* checked accessors of debug builds.
 	* @param row (j)
 	* @param column (i)
 	*/
-	double& Matrix::operator()(int j, int i) {
-		if (j > _m || i > _n) {
-			std::cerr << "FATAL ERROR: the element requested is outside of the matrix.\n";
-			exit(-1);
-		}
-
-		return _A[j * _n + i];
+	void Matrix::outOfBounds(int j, int i) const {
+		std::cerr << "FATAL ERROR: the element (" << j << ", " << i
+			<< ") requested is outside of the " << _m << "x" << _n << " matrix.\n";
+		exit(-1);
 	}
 
 	/**
 	* Check if two matrix are equal
 	* @param matrix to check for equality
 	*/
-	bool Matrix::operator==(Matrix B) const {
+	bool Matrix::operator==(const Matrix B) const {
 
 		if (_m != B.rowCount() || _n != B.colCount()) return false;
 
-		for (int a = 0; a < _m * _n; a++) {
-			if ((*this)(a) != B(a)) return false;
-		}
-
-		return true;
+		return std::equal(data(), data() + _m * _n, B.data());
 	}
 
 	/**
 	* Matrix addition
 	* @param matrix to add
 	*/
-	Matrix Matrix::operator+(Matrix B) const {
+	Matrix Matrix::operator+(const Matrix B) const {
 
 		if (B.rowCount() != _m || B.colCount() != _n) {
 			std::cerr << "ERROR: Sizes aren't equal. Matrix addition is not defined\n";
@@ -210,9 +195,12 @@ namespace als {
 		}
 
 		Matrix res(_m, _n);
+		const double* a = data();
+		const double* b = B.data();
+		double* c = res.data();
 
-		for (int a = 0; a < _m * _n; a++) {
-			res(a) = (*this)(a) + B(a);
+		for (int x = 0; x < _m * _n; x++) {
+			c[x] = a[x] + b[x];
 		}
 
 		return res;
@@ -225,9 +213,11 @@ namespace als {
 	Matrix Matrix::operator*(double scalar) const {
 
 		Matrix res(_m, _n);
+		const double* a = data();
+		double* c = res.data();
 
-		for (int a = 0; a < _m * _n; a++) {
-			res(a) = (*this)(a) * scalar;
+		for (int x = 0; x < _m * _n; x++) {
+			c[x] = a[x] * scalar;
 		}
 
 		return res;
@@ -238,29 +228,44 @@ namespace als {
 	* @param B matrix to multplity by
 	* @return new matrix
 	*/
-	Matrix Matrix::operator*(Matrix B) const {
+	Matrix Matrix::operator*(const Matrix B) const {
+		return product(*this, B);
+	}
 
-		if (_n != B.rowCount()) {
-			std::cerr << "ERROR: Sizes don't match, matrix multiplication is not defined.\n";
-			return Matrix(1, 1);
-		}
+	/**
+	* Matrix multiplication with a choice of algorithm. Strassen-Winograd
+	* does fewer operations on large matrices but its rounding errors grow
+	* faster with the size, so AUTO only uses it past the crossover.
+	* @param A left matrix (m x n)
+	* @param B right matrix (n x p)
+	* @param algorithm CLASSIC blocked product, STRASSEN recursion or AUTO
+	* @return new matrix
+	*/
+	Matrix Matrix::product(const Matrix A, const Matrix B, productAlgorithm algorithm) {
 
-		const int newSize = _m * B.colCount();
+		ALS_PROFILE_SCOPE("Matrix::operator*");
 
-		Matrix res(_m, B.colCount());
+		const int m = A.rowCount();
+		const int n = A.colCount();
+		const int p = B.colCount();
 
-		for (int a = 0; a < newSize; a++) {
+		if (n != B.rowCount()) {
+			std::cerr << "ERROR: Sizes don't match, matrix multiplication is not defined.\n";
+			return Matrix(1, 1);
+		}
 
-			int j = a / _m;
-			int i = a % B.colCount();
+		Matrix res(m, p);
 
-			double elem = 0;
+		ALS_COUNT_FLOPS(2ull * m * n * p);
 
-			for (int x = 0; x < _n; x++) {
-				elem += (*this)(j, x) * B(x, i);
-			}
+		bool strassen = algorithm == productAlgorithm::STRASSEN
+			|| (algorithm == productAlgorithm::AUTO && std::min({ m, n, p }) >= kernels::strassenCrossover);
 
-			res(a) = elem;
+		if (strassen) {
+			kernels::strassen(m, p, n, A.data(), n, B.data(), p, res.data(), p);
+		}
+		else {
+			kernels::gemm(m, p, n, A.data(), n, B.data(), p, res.data(), p);
 		}
 
 		return res;
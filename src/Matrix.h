@@ -1,5 +1,13 @@
 #pragma once
+#include <atomic>
 #include <iostream>
+#include <memory>
+#include <vector>
+
+/// Element accessors only check their bounds in debug builds.
+#if defined(_DEBUG) || !defined(NDEBUG)
+#define ALS_CHECKED_ACCESS 1
+#endif
 
 namespace als {
 
@@ -9,40 +17,154 @@ namespace als {
 		INFINITE,
 	};
 
+	enum class resultStatus {
+		OK,
+		SIZE_MISMATCH,
+		NOT_SQUARE,
+		SINGULAR,
+		NOT_INTEGER,
+		OVERFLOW,
+		IO_ERROR,
+	};
+
+	enum class solvePrecision {
+		DOUBLE,
+		MIXED,
+	};
+
+	enum class productAlgorithm {
+		CLASSIC,
+		STRASSEN,
+		AUTO,
+	};
+
+	class Vector;
+	struct ParametricSolution;
+	struct SleResult;
+	struct InverseResult;
+	struct ScalarResult;
+	struct LogDeterminant;
+	struct ScaledDeterminant;
+
 	/**
-	* Mathematical matrix class
+	* Mathematical matrix class. Copies share their storage until one of them
+	* is written to, which first gives that one a private copy (copy on write).
+	* The kernels write through a writable() view, which makes the storage
+	* private once instead of at every element.
 	*/
 	class Matrix {
 
 		int _m, _n;
 		std::shared_ptr<double[]> _A;
 
+		[[noreturn]] void outOfBounds(int j, int i) const;
+		bool mirrorsItself(double sign) const;
+		void copyStorage(bool keepContents);
+
+		/**
+		* Make the storage private before a write. The fence orders the write
+		* after the reads done through copies released by other threads.
+		* @param keepContents false when every element is about to be overwritten
+		*/
+		void detach(bool keepContents = true) {
+			if (_A.use_count() > 1) copyStorage(keepContents);
+			else std::atomic_thread_fence(std::memory_order_acquire);
+		}
+
 	public:
 
 		Matrix(int m, int n);
 		static Matrix Identity(int dim);
 		static Matrix Null(int dim);
-		void fill(double* B);
+		void fill(const double* B);
+		Matrix clone() const;
+		/// Read-only copy sharing the storage, readable from any number of
+		/// threads while this matrix keeps being written to.
+		const Matrix snapshot() const { return *this; }
+		bool isShared() const { return _A.use_count() > 1; }
 		void print() const;
 
 		int rowCount() const { return _m; }
 		int colCount() const { return _n; }
 
-		int rank() const;
+		int rank(double tolerance = -1) const;
 		double trace() const;
+		ScalarResult tryTrace() const;
 
-		bool operator==(Matrix B) const;
+		bool operator==(const Matrix B) const;
+
+		/**
+		* Element access, bounds checked in debug builds only.
+		* @param linear position (a) or row (j) and column (i)
+		*/
+		double operator()(int a) const {
+#ifdef ALS_CHECKED_ACCESS
+			if (a < 0 || a >= _m * _n) outOfBounds(a / (_n ? _n : 1), a % (_n ? _n : 1));
+#endif
+			return _A[a];
+		}
+		double& operator()(int a) {
+#ifdef ALS_CHECKED_ACCESS
+			if (a < 0 || a >= _m * _n) outOfBounds(a / (_n ? _n : 1), a % (_n ? _n : 1));
+#endif
+			detach();
+			return _A[a];
+		}
+		double operator()(int j, int i) const {
+#ifdef ALS_CHECKED_ACCESS
+			if (j < 0 || j >= _m || i < 0 || i >= _n) outOfBounds(j, i);
+#endif
+			return _A[j * _n + i];
+		}
+		double& operator()(int j, int i) {
+#ifdef ALS_CHECKED_ACCESS
+			if (j < 0 || j >= _m || i < 0 || i >= _n) outOfBounds(j, i);
+#endif
+			detach();
+			return _A[j * _n + i];
+		}
+
+		/**
+		* Unchecked access to the storage for the internal kernels.
+		* The data is row major, row j starts at data() + j * colCount().
+		* The mutable pointers detach the storage, and must not be written
+		* through anymore once the matrix has been copied.
+		*/
+		double* data() { detach(); return _A.get(); }
+		const double* data() const { return _A.get(); }
+		double* row(int j) { detach(); return _A.get() + j * _n; }
+		const double* row(int j) const { return _A.get() + j * _n; }
+
+		/**
+		* Element access of the kernels, without the copy on write check of
+		* every element: the storage is detached once, when the view is taken.
+		* Like the pointers of data(), a view must not be written through
+		* anymore once the matrix has been copied.
+		*/
+		class Writable {
+
+			double* _a;
+			int _n;
+
+		public:
+
+			Writable(double* a, int n) : _a(a), _n(n) {}
+
+			double& operator()(int a) const { return _a[a]; }
+			double& operator()(int j, int i) const { return _a[j * _n + i]; }
+			double* row(int j) const { return _a + j * _n; }
+		};
+
+		Writable writable() { detach(); return Writable(_A.get(), _n); }
 
-		double operator()(int a) const;
-		double& operator()(int a);
-		double operator()(int j, int i) const;
-		double& operator()(int j, int i);
 		Matrix transpose() const;
+		void transposeInPlace();
 
-		Matrix operator+(Matrix B) const;
+		Matrix operator+(const Matrix B) const;
 
 		Matrix operator*(double scalar) const;
-		Matrix operator*(Matrix B) const;
+		Matrix operator*(const Matrix B) const;
+		static Matrix product(const Matrix A, const Matrix B, productAlgorithm algorithm = productAlgorithm::AUTO);
 
 		/*** Identities ***/
 		bool isSquare() const;
@@ -62,18 +184,89 @@ namespace als {
 		void scaleEquation(int equation, double scalar);
 		void swapEquations(int equation1, int equation2);
 		void addOtherEquation(int equation1, int equation2, double scalar);
-		static Matrix toRowEchelon(const Matrix A, Matrix* b = nullptr, double* alpha = nullptr);
-		static Matrix toReducedRowEchelon(const Matrix A, Matrix* b = nullptr, double* alpha = nullptr);
+		static Matrix toRowEchelon(const Matrix A, Matrix* b = nullptr, double* alpha = nullptr,
+			std::vector<int>* pivots = nullptr);
+		static Matrix toReducedRowEchelon(const Matrix A, Matrix* b = nullptr, double* alpha = nullptr,
+			std::vector<int>* pivots = nullptr);
+		static double eliminationTolerance(const Matrix A);
 		static Matrix augmentedMatrix(const Matrix A, const Matrix b);
-		static sleSolution solveSLE(const Matrix A, Matrix b, Matrix* x);
+		static SleResult solve(const Matrix A, const Matrix b, solvePrecision precision = solvePrecision::DOUBLE);
+		static SleResult solve(const Matrix A, const Vector& b, solvePrecision precision = solvePrecision::DOUBLE);
+		static sleSolution solveSLE(const Matrix A, Matrix b, Matrix* x, ParametricSolution* general = nullptr,
+			resultStatus* status = nullptr);
+		static ParametricSolution generalSolution(const Matrix reduced, const Matrix reducedB,
+			const std::vector<int>& pivots);
+		static Matrix leastSquares(const Matrix A, const Matrix b);
 
 		/*** Determinant and inverse ***/
 		static double determinant(const Matrix A);
 		static double determinant(const Matrix A, double alpha);
+		static LogDeterminant logDeterminant(const Matrix A);
+		static ScaledDeterminant scaledDeterminant(const Matrix A);
 		bool isInvertible() const;
+		double conditionNumber() const;
 		double cofactor(int j, int i) const;
-		static Matrix inverse(Matrix A);
+		static InverseResult invert(const Matrix A, solvePrecision precision = solvePrecision::DOUBLE);
+		static Matrix inverse(const Matrix A);
 		static Matrix subMatrix(const Matrix A, int j, int i);
 		static Matrix adjugate(const Matrix A);
 	};
-}
\ No newline at end of file
+
+	/**
+	* Every solution of a compatible SLE: x = particular + nullSpace * t
+	* for any vector t of the free variables.
+	*/
+	struct ParametricSolution {
+		Matrix particular;
+		Matrix nullSpace;
+		std::vector<int> pivotColumns;
+		std::vector<int> freeVariables;
+	};
+
+	/**
+	* Outcome of an SLE resolution, without any console output.
+	*/
+	struct SleResult {
+		resultStatus status;
+		sleSolution kind;
+		int rank;
+		double determinant;
+		ParametricSolution general;
+		Matrix reducedSystem;
+		double residual;
+		double backwardError;
+	};
+
+	/**
+	* Outcome of a matrix inversion, without any console output.
+	*/
+	struct InverseResult {
+		resultStatus status;
+		Matrix inverse;
+		double determinant;
+		int rank;
+	};
+
+	struct ScalarResult {
+		resultStatus status;
+		double value;
+	};
+
+	/**
+	* det(A) = sign * exp(logAbs).
+	*/
+	struct LogDeterminant {
+		resultStatus status;
+		int sign;
+		double logAbs;
+	};
+
+	/**
+	* det(A) = mantissa * 2^exponent, with |mantissa| in [0.5, 1) or 0.
+	*/
+	struct ScaledDeterminant {
+		resultStatus status;
+		double mantissa;
+		long long exponent;
+	};
+}
@@ -0,0 +1,164 @@
+#include "MixedPrecision.h"
+#include "Instrumentation.h"
+#include "Kernels.h"
+#include "LU.h"
+#include "Reductions.h"
+#include "Vector.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+/// <summary>
+/// Implementation of the mixed precision iterative refinement.
+/// </summary>
+
+namespace als {
+
+	namespace {
+
+		/**
+		* r = b - A * x, all in double precision.
+		* A single right hand side goes through gemv with r starting from b,
+		* several through the general product.
+		*/
+		Matrix residual(const Matrix& A, const Matrix& x, const Matrix& b) {
+
+			if (b.colCount() == 1) {
+				Vector r = Vector::fromMatrix(b);
+				gemv(-1, A, Vector::fromMatrix(x), 1, r);
+				return r.toMatrix();
+			}
+
+			Matrix r = A * x;
+			double* rr = r.data();
+			const double* bb = b.data();
+
+			for (int a = 0; a < b.rowCount() * b.colCount(); a++) {
+				rr[a] = bb[a] - rr[a];
+			}
+
+			return r;
+		}
+
+		/**
+		* Backward error of the worst column from an already computed residual.
+		*/
+		double columnBackwardError(const Matrix& r, const Matrix& x, const Matrix& b, double aNorm) {
+
+			double worst = 0;
+
+			for (int c = 0; c < b.colCount(); c++) {
+
+				double rNorm = 0, xNorm = 0, bNorm = 0;
+
+				for (int j = 0; j < b.rowCount(); j++) {
+					rNorm = std::max(rNorm, std::abs(r(j, c)));
+					bNorm = std::max(bNorm, std::abs(b(j, c)));
+				}
+				for (int j = 0; j < x.rowCount(); j++) {
+					xNorm = std::max(xNorm, std::abs(x(j, c)));
+				}
+
+				double denominator = aNorm * xNorm + bNorm;
+				worst = std::max(worst, denominator > 0 ? rNorm / denominator : rNorm);
+			}
+
+			return worst;
+		}
+	}
+
+	/**
+	* Normwise backward error of the worst column:
+	* ||b - A * x|| / (||A|| * ||x|| + ||b||) in the infinity norm.
+	*/
+	double backwardError(const Matrix A, const Matrix x, const Matrix b) {
+		return columnBackwardError(residual(A, x, b), x, b, reductions::normInf(A));
+	}
+
+	/**
+	* Solve A * x = b by factoring A in single precision and refining the
+	* solution on double precision residuals. Falls back to a double precision
+	* factorization when the single precision one fails or refinement stalls.
+	* Single precision halves the bandwidth and doubles the SIMD width of the
+	* O(n^3) part, the refinement steps are O(n^2).
+	* @param A square matrix
+	* @param b right hand sides (n x k)
+	* @param maxIterations refinement steps before falling back
+	* @return solution with its achieved backward error
+	*/
+	RefinedSolution solveMixedPrecision(const Matrix A, const Matrix b, int maxIterations) {
+
+		ALS_PROFILE_SCOPE("solveMixedPrecision");
+
+		const int n = A.rowCount();
+		const int k = b.colCount();
+
+		if (!A.isSquare() || b.rowCount() != n) {
+			std::cerr << "ERROR: The given SLE doesn't have proper sizes." << std::endl;
+			return { Matrix::Null(1), 0, 0, std::numeric_limits<double>::infinity(), false, false };
+		}
+
+		const double tolerance = std::sqrt(static_cast<double>(n)) * std::numeric_limits<double>::epsilon();
+
+		auto fallback = [&](int iterations) {
+			LUDecomposition lu(A);
+			Matrix x = lu.solve(b);
+			double error = backwardError(A, x, b);
+			return RefinedSolution{ x, lu.determinant(), iterations, error, error <= tolerance, true };
+		};
+
+		const double aNorm = reductions::normInf(A);
+
+		// The entries must be representable in single precision
+		if (aNorm > std::numeric_limits<float>::max()) return fallback(0);
+
+		std::vector<float> lu(A.data(), A.data() + n * n);
+		std::vector<int> pivots(n);
+
+		if (!kernels::luFactor(lu.data(), n, n, pivots.data())) return fallback(0);
+
+		ALS_COUNT_FLOPS(2ull * n * n * n / 3);
+
+		// Determinant of the single precision factors, accumulated in double
+		double mantissa = 1;
+		int exponent = 0;
+		for (int i = 0; i < n; i++) {
+			int e;
+			mantissa = std::frexp(mantissa * (pivots[i] != i ? -1.0 : 1.0) * lu[i * n + i], &e);
+			exponent += e;
+		}
+		const double determinant = std::ldexp(mantissa, exponent);
+
+		std::vector<float> correction(b.data(), b.data() + n * k);
+		kernels::luSolve(lu.data(), n, n, pivots.data(), correction.data(), k, k);
+
+		Matrix x(n, k);
+		std::copy(correction.begin(), correction.end(), x.data());
+
+		double previousError = std::numeric_limits<double>::infinity();
+
+		for (int iteration = 0; ; iteration++) {
+
+			Matrix r = residual(A, x, b);
+			double error = columnBackwardError(r, x, b, aNorm);
+
+			if (error <= tolerance) return { x, determinant, iteration, error, true, false };
+
+			// Stop early when the error no longer halves: A is too
+			// ill-conditioned for the single precision factors
+			if (iteration == maxIterations || error > 0.5 * previousError) {
+				return fallback(iteration);
+			}
+			previousError = error;
+
+			// The correction only needs single precision, the residual does not
+			std::copy(r.data(), r.data() + n * k, correction.begin());
+			kernels::luSolve(lu.data(), n, n, pivots.data(), correction.data(), k, k);
+
+			double* xx = x.data();
+			for (int a = 0; a < n * k; a++) xx[a] += correction[a];
+		}
+	}
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include "Matrix.h"
+
+namespace als {
+
+	/**
+	* Outcome of a mixed precision solve.
+	*/
+	struct RefinedSolution {
+		Matrix x;
+		double determinant;
+		int iterations;
+		double backwardError;
+		bool converged;
+		bool usedFallback;
+	};
+
+	RefinedSolution solveMixedPrecision(const Matrix A, const Matrix b, int maxIterations = 30);
+
+	double backwardError(const Matrix A, const Matrix x, const Matrix b);
+}
@@ -0,0 +1,555 @@
+#include "OutOfCore.h"
+#include "Kernels.h"
+#include "Instrumentation.h"
+
+#include <atomic>
+#include <cmath>
+#include <filesystem>
+#include <future>
+#include <tuple>
+#include <utility>
+
+/// <summary>
+/// Implementation of the tiled on-disk matrix and of the out-of-core
+/// operations. The next tiles are read by a background task while the
+/// current ones are processed with the in-core kernels.
+/// </summary>
+
+namespace als {
+
+	/**
+	* Create the file of the matrix, sized for all its tiles.
+	* @param path file to create, overwritten if it exists
+	* @param tile side of the tiles
+	* @param temporary remove the file with the object
+	*/
+	TiledMatrix::TiledMatrix(const std::string& path, int m, int n, int tile, bool temporary)
+		: _path(path), _m(m), _n(n), _tile(std::max(tile, 1)), _temporary(temporary) {
+
+		_file.open(path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+
+		if (!_file.is_open()) {
+			std::cerr << "ERROR: Could not create the file " << path << " of the tiled matrix.\n" << std::endl;
+			return;
+		}
+
+		_file.close();
+
+		// One slot past the last tile column
+		std::error_code error;
+		std::filesystem::resize_file(path, offset(0, tileCols()), error);
+
+		if (error) {
+			std::cerr << "ERROR: Could not size the file " << path << " of the tiled matrix: " << error.message() << "\n" << std::endl;
+			return;
+		}
+
+		_file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+	}
+
+	TiledMatrix::~TiledMatrix() {
+
+		if (_file.is_open()) _file.close();
+
+		if (_temporary) {
+			std::error_code ignored;
+			std::filesystem::remove(_path, ignored);
+		}
+	}
+
+	/**
+	* Tiled matrix in a uniquely named file of the temporary directory,
+	* removed with the object.
+	*/
+	TiledMatrix TiledMatrix::temporary(int m, int n, int tile) {
+
+		static std::atomic<unsigned> counter = 0;
+
+		std::filesystem::path path = std::filesystem::temp_directory_path()
+			/ ("als-" + std::to_string(reinterpret_cast<uintptr_t>(&counter)) + "-" + std::to_string(counter++) + ".tiles");
+
+		return TiledMatrix(path.string(), m, n, tile, true);
+	}
+
+	/**
+	* Largest tile keeping the out-of-core operations within a memory budget.
+	* The products hold five tiles at once, the LU three column panels of
+	* height n.
+	* @param bytes memory budget
+	* @param n largest dimension of the matrices involved
+	*/
+	int TiledMatrix::tileForBudget(size_t bytes, int n) {
+
+		const double doubles = static_cast<double>(bytes) / sizeof(double);
+
+		int tile = static_cast<int>(std::min(std::sqrt(doubles / 5), doubles / (3.0 * std::max(n, 1))));
+
+		return std::max(tile, 1);
+	}
+
+	/**
+	* Position of a tile. Every tile has a slot of tile * tile elements,
+	* slots are ordered by tile column then tile row.
+	*/
+	uint64_t TiledMatrix::offset(int tj, int ti) const {
+		return (static_cast<uint64_t>(ti) * tileRows() + tj) * _tile * _tile * sizeof(double);
+	}
+
+	/**
+	* A failed seek, read or write sets the state of the stream, which then
+	* ignores every later operation: the state is cleared after each tile.
+	* @return false if the file is not open or the tile could not be read
+	*/
+	bool TiledMatrix::readTile(int tj, int ti, Matrix* tile) const {
+
+		*tile = Matrix(tileHeight(tj), tileWidth(ti));
+
+		const std::streamsize bytes = static_cast<std::streamsize>(sizeof(double)) * tile->rowCount() * tile->colCount();
+
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		if (!_file.is_open()) return false;
+
+		_file.seekg(offset(tj, ti));
+		if (_file) _file.read(reinterpret_cast<char*>(tile->data()), bytes);
+
+		const bool read = _file && _file.gcount() == bytes;
+		_file.clear();
+
+		return read;
+	}
+
+	/**
+	* @return false if the file is not open or the tile could not be written
+	*/
+	bool TiledMatrix::writeTile(int tj, int ti, const Matrix& tile) {
+
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		if (!_file.is_open()) return false;
+
+		_file.seekp(offset(tj, ti));
+		if (_file) {
+			_file.write(reinterpret_cast<const char*>(tile.data()),
+				static_cast<std::streamsize>(sizeof(double)) * tileHeight(tj) * tileWidth(ti));
+		}
+
+		const bool written = static_cast<bool>(_file);
+		_file.clear();
+
+		return written;
+	}
+
+	/**
+	* Every tile of a tile column, stacked (m x tileWidth(ti)).
+	*/
+	bool TiledMatrix::readColumnPanel(int ti, Matrix* panel) const {
+
+		const int w = tileWidth(ti);
+		*panel = Matrix(_m, w);
+
+		Matrix tile(1, 1);
+
+		for (int tj = 0; tj < tileRows(); tj++) {
+			if (!readTile(tj, ti, &tile)) return false;
+			std::copy_n(tile.data(), tile.rowCount() * w, panel->row(tj * _tile));
+		}
+
+		return true;
+	}
+
+	bool TiledMatrix::writeColumnPanel(int ti, const Matrix& panel) {
+
+		const int w = tileWidth(ti);
+
+		for (int tj = 0; tj < tileRows(); tj++) {
+			Matrix tile(tileHeight(tj), w);
+			std::copy_n(panel.row(tj * _tile), tile.rowCount() * w, tile.data());
+			if (!writeTile(tj, ti, tile)) return false;
+		}
+
+		return true;
+	}
+
+	/**
+	* Copy an in-memory matrix of the same size to the disk.
+	*/
+	bool TiledMatrix::fill(const Matrix& A) {
+
+		for (int ti = 0; ti < tileCols(); ti++) {
+			for (int tj = 0; tj < tileRows(); tj++) {
+
+				Matrix tile(tileHeight(tj), tileWidth(ti));
+
+				for (int r = 0; r < tile.rowCount(); r++) {
+					std::copy_n(A.row(tj * _tile + r) + ti * _tile, tile.colCount(), tile.row(r));
+				}
+
+				if (!writeTile(tj, ti, tile)) return false;
+			}
+		}
+
+		return true;
+	}
+
+	/**
+	* Load the whole matrix, for the sizes that fit in memory.
+	*/
+	bool TiledMatrix::toMatrix(Matrix* A) const {
+
+		*A = Matrix(_m, _n);
+
+		Matrix tile(1, 1);
+
+		for (int ti = 0; ti < tileCols(); ti++) {
+			for (int tj = 0; tj < tileRows(); tj++) {
+				if (!readTile(tj, ti, &tile)) return false;
+				for (int r = 0; r < tile.rowCount(); r++) {
+					std::copy_n(tile.row(r), tile.colCount(), A->row(tj * _tile + r) + ti * _tile);
+				}
+			}
+		}
+
+		return true;
+	}
+
+	/**
+	* C = A * B tile by tile. While a pair of tiles of A and B is multiplied
+	* into the tile of C, the next pair is read in the background, so five
+	* tiles are in memory at most.
+	* @param C result, with the same tile size as A and B
+	* @return IO_ERROR if a tile could not be read or written
+	*/
+	resultStatus outOfCoreMultiply(const TiledMatrix& A, const TiledMatrix& B, TiledMatrix& C) {
+
+		ALS_PROFILE_SCOPE("outOfCoreMultiply");
+
+		if (A.colCount() != B.rowCount() || C.rowCount() != A.rowCount() || C.colCount() != B.colCount()
+			|| A.tile() != B.tile() || A.tile() != C.tile()) {
+			return resultStatus::SIZE_MISMATCH;
+		}
+
+		if (!A.isOpen() || !B.isOpen() || !C.isOpen()) return resultStatus::IO_ERROR;
+
+		const int inner = A.tileCols();
+
+		auto readPair = [&](int tj, int ti, int tk) {
+			return std::async(std::launch::async, [&A, &B, tj, ti, tk]() {
+				Matrix a(1, 1), b(1, 1);
+				const bool read = A.readTile(tj, tk, &a) && B.readTile(tk, ti, &b);
+				return std::tuple<bool, Matrix, Matrix>(read, a, b);
+			});
+		};
+
+		for (int tj = 0; tj < C.tileRows(); tj++) {
+			for (int ti = 0; ti < C.tileCols(); ti++) {
+
+				const int h = C.tileHeight(tj);
+				const int w = C.tileWidth(ti);
+
+				Matrix c(h, w);
+				std::fill_n(c.data(), h * w, 0.0);
+
+				auto next = readPair(tj, ti, 0);
+
+				for (int tk = 0; tk < inner; tk++) {
+
+					auto [read, a, b] = next.get();
+					if (!read) return resultStatus::IO_ERROR;
+					if (tk + 1 < inner) next = readPair(tj, ti, tk + 1);
+
+					ALS_COUNT_FLOPS(2ull * h * w * a.colCount());
+
+					kernels::gemm(h, w, a.colCount(), a.data(), a.colCount(), b.data(), w, c.data(), w, true);
+				}
+
+				if (!C.writeTile(tj, ti, c)) return resultStatus::IO_ERROR;
+			}
+		}
+
+		return resultStatus::OK;
+	}
+
+	/**
+	* T = A^T tile by tile with the blocked in-core transposition,
+	* reading the next tile in the background.
+	* @param T result, with the same tile size as A
+	* @return IO_ERROR if a tile could not be read or written
+	*/
+	resultStatus outOfCoreTranspose(const TiledMatrix& A, TiledMatrix& T) {
+
+		ALS_PROFILE_SCOPE("outOfCoreTranspose");
+
+		if (T.rowCount() != A.colCount() || T.colCount() != A.rowCount() || A.tile() != T.tile()) {
+			return resultStatus::SIZE_MISMATCH;
+		}
+
+		if (!A.isOpen() || !T.isOpen()) return resultStatus::IO_ERROR;
+
+		const int count = A.tileRows() * A.tileCols();
+
+		auto readTile = [&A](int t) {
+			return std::async(std::launch::async, [&A, t]() {
+				Matrix tile(1, 1);
+				const bool read = A.readTile(t % A.tileRows(), t / A.tileRows(), &tile);
+				return std::pair<bool, Matrix>(read, tile);
+			});
+		};
+
+		auto next = readTile(0);
+
+		// In file order, tile column by tile column
+		for (int t = 0; t < count; t++) {
+
+			auto [read, tile] = next.get();
+			if (!read) return resultStatus::IO_ERROR;
+			if (t + 1 < count) next = readTile(t + 1);
+
+			Matrix transposed(tile.colCount(), tile.rowCount());
+			kernels::transpose(tile.data(), tile.rowCount(), tile.colCount(), tile.colCount(),
+				transposed.data(), transposed.colCount());
+
+			if (!T.writeTile(t / A.tileRows(), t % A.tileRows(), transposed)) return resultStatus::IO_ERROR;
+		}
+
+		return resultStatus::OK;
+	}
+
+	namespace {
+
+		/**
+		* Apply the row interchanges of steps [from, to) to a panel.
+		*/
+		void applyInterchanges(Matrix& panel, const std::vector<int>& pivots, int from, int to) {
+
+			for (int k = from; k < to; k++) {
+				if (pivots[k] != k) panel.swapEquations(k, pivots[k]);
+			}
+		}
+
+		/**
+		* Update a column panel with the factored panel of an earlier block
+		* column: triangular solve with its unit lower diagonal block, then
+		* elimination of the rows below.
+		* @param start first row and column of the earlier block
+		*/
+		void updatePanel(Matrix& panel, const Matrix& factored, int start) {
+
+			const int n = panel.rowCount();
+			const int w = panel.colCount();
+			const int wq = factored.colCount();
+			const int below = n - start - wq;
+
+			// L(start:start+wq, :) * X = panel(start:start+wq, :)
+			for (int r = 1; r < wq; r++) {
+				double* pr = panel.row(start + r);
+				const double* l = factored.row(start + r);
+				for (int c = 0; c < r; c++) {
+					const double* pc = panel.row(start + c);
+					for (int i = 0; i < w; i++) pr[i] -= l[c] * pc[i];
+				}
+			}
+
+			if (below <= 0) return;
+
+			ALS_COUNT_FLOPS(2ull * below * w * wq);
+
+			// panel(below) -= L(below) * X, through the product kernel
+			Matrix negated(wq, w);
+			for (int a = 0; a < wq * w; a++) negated(a) = -panel.row(start)[a];
+
+			kernels::gemm(below, w, wq, factored.row(start + wq), wq, negated.data(), w,
+				panel.row(start + wq), w, true);
+		}
+
+		/**
+		* Partial pivoting LU of the rows [start, n) of a column panel.
+		* @return false if a pivot is zero
+		*/
+		bool factorPanel(Matrix& panel, int start, std::vector<int>& pivots) {
+
+			const int n = panel.rowCount();
+			const int w = panel.colCount();
+			bool regular = true;
+
+			for (int c = 0; c < w && start + c < n; c++) {
+
+				const int k = start + c;
+
+				int best = k;
+				for (int r = k + 1; r < n; r++) {
+					if (std::abs(panel(r, c)) > std::abs(panel(best, c))) best = r;
+				}
+
+				pivots[k] = best;
+				if (best != k) {
+					panel.swapEquations(k, best);
+					ALS_COUNT_PIVOT();
+				}
+
+				const double pivot = panel(k, c);
+				if (pivot == 0) {
+					regular = false;
+					continue;
+				}
+
+				const double* pivotRow = panel.row(k);
+
+				for (int r = k + 1; r < n; r++) {
+					double* row = panel.row(r);
+					const double l = row[c] / pivot;
+					row[c] = l;
+					for (int i = c + 1; i < w; i++) row[i] -= l * pivotRow[i];
+				}
+			}
+
+			return regular;
+		}
+	}
+
+	/**
+	* Left-looking LU with partial pivoting, in place and by block columns.
+	* Each column panel is loaded, brought up to date with every panel on its
+	* left streamed from the disk (the next one is read in the background),
+	* factored in memory and written back. Three panels of height n are in
+	* memory at most. The interchanges made after a panel was written are
+	* applied to it in a last pass, so the file ends with the packed L and U
+	* of P * A.
+	* @param pivots receives the row swapped with row k at step k
+	* @return IO_ERROR if a panel could not be read or written, the file
+	* then holding a partial factorization
+	*/
+	resultStatus outOfCoreLU(TiledMatrix& A, std::vector<int>* pivots) {
+
+		ALS_PROFILE_SCOPE("outOfCoreLU");
+
+		if (A.rowCount() != A.colCount()) return resultStatus::NOT_SQUARE;
+		if (!A.isOpen()) return resultStatus::IO_ERROR;
+
+		const int n = A.rowCount();
+		const int t = A.tile();
+		const int panels = A.tileCols();
+
+		std::vector<int>& ipiv = *pivots;
+		ipiv.resize(n);
+
+		bool regular = true;
+
+		auto readPanel = [&A](int q) {
+			return std::async(std::launch::async, [&A, q]() {
+				Matrix panel(1, 1);
+				const bool read = A.readColumnPanel(q, &panel);
+				return std::pair<bool, Matrix>(read, panel);
+			});
+		};
+
+		Matrix panel(1, 1);
+
+		for (int p = 0; p < panels; p++) {
+
+			if (!A.readColumnPanel(p, &panel)) return resultStatus::IO_ERROR;
+			applyInterchanges(panel, ipiv, 0, p * t);
+
+			if (p > 0) {
+
+				auto next = readPanel(0);
+
+				for (int q = 0; q < p; q++) {
+
+					auto [read, factored] = next.get();
+					if (!read) return resultStatus::IO_ERROR;
+					if (q + 1 < p) next = readPanel(q + 1);
+
+					applyInterchanges(factored, ipiv, (q + 1) * t, p * t);
+					updatePanel(panel, factored, q * t);
+				}
+			}
+
+			regular = factorPanel(panel, p * t, ipiv) && regular;
+
+			if (!A.writeColumnPanel(p, panel)) return resultStatus::IO_ERROR;
+		}
+
+		// Interchanges of the later panels
+		for (int q = 0; q + 1 < panels; q++) {
+			if (!A.readColumnPanel(q, &panel)) return resultStatus::IO_ERROR;
+			applyInterchanges(panel, ipiv, (q + 1) * t, n);
+			if (!A.writeColumnPanel(q, panel)) return resultStatus::IO_ERROR;
+		}
+
+		return regular ? resultStatus::OK : resultStatus::SINGULAR;
+	}
+
+	/**
+	* Solve A * x = b with the factors of outOfCoreLU, streaming the
+	* column panels once forward and once backward.
+	* @param b right hand sides in memory (n x k)
+	* @param x receives the solutions (n x k)
+	* @return IO_ERROR if a panel could not be read
+	*/
+	resultStatus outOfCoreLUSolve(const TiledMatrix& LU, const std::vector<int>& pivots, const Matrix b, Matrix* x) {
+
+		ALS_PROFILE_SCOPE("outOfCoreLUSolve");
+
+		const int n = LU.rowCount();
+		const int k = b.colCount();
+		const int t = LU.tile();
+		const int panels = LU.tileCols();
+
+		if (b.rowCount() != n || static_cast<int>(pivots.size()) != n) return resultStatus::SIZE_MISMATCH;
+		if (!LU.isOpen()) return resultStatus::IO_ERROR;
+
+		*x = b;
+		applyInterchanges(*x, pivots, 0, n);
+
+		auto readPanel = [&LU](int q) {
+			return std::async(std::launch::async, [&LU, q]() {
+				Matrix panel(1, 1);
+				const bool read = LU.readColumnPanel(q, &panel);
+				return std::pair<bool, Matrix>(read, panel);
+			});
+		};
+
+		// L * y = P * b, column oriented
+		auto next = readPanel(0);
+		for (int q = 0; q < panels; q++) {
+
+			auto [read, panel] = next.get();
+			if (!read) return resultStatus::IO_ERROR;
+			if (q + 1 < panels) next = readPanel(q + 1);
+
+			for (int c = 0; c < panel.colCount(); c++) {
+				const int col = q * t + c;
+				const double* xc = x->row(col);
+				for (int r = col + 1; r < n; r++) {
+					const double l = panel(r, c);
+					double* xr = x->row(r);
+					for (int i = 0; i < k; i++) xr[i] -= l * xc[i];
+				}
+			}
+		}
+
+		// U * x = y, from the last panel
+		next = readPanel(panels - 1);
+		for (int q = panels - 1; q >= 0; q--) {
+
+			auto [read, panel] = next.get();
+			if (!read) return resultStatus::IO_ERROR;
+			if (q > 0) next = readPanel(q - 1);
+
+			for (int c = panel.colCount() - 1; c >= 0; c--) {
+				const int col = q * t + c;
+				double* xc = x->row(col);
+				const double u = panel(col, c);
+				for (int i = 0; i < k; i++) xc[i] /= u;
+				for (int r = 0; r < col; r++) {
+					const double v = panel(r, c);
+					double* xr = x->row(r);
+					for (int i = 0; i < k; i++) xr[i] -= v * xc[i];
+				}
+			}
+		}
+
+		return resultStatus::OK;
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include "Matrix.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace als {
+
+	/**
+	* Matrix stored on disk by square tiles, so that it can be larger than
+	* the memory. The tiles are laid out by tile column, which makes the
+	* column panels read by the out-of-core LU contiguous in the file.
+	* Tiles never written read as zeros. Safe to read and write from
+	* several threads. The reads and writes return false when the file
+	* could not be accessed, and leave the stream usable for the next ones.
+	*/
+	class TiledMatrix {
+
+		std::string _path;
+		mutable std::fstream _file;
+		mutable std::mutex _mutex;
+		int _m, _n, _tile;
+		bool _temporary;
+
+		uint64_t offset(int tj, int ti) const;
+
+	public:
+
+		TiledMatrix(const std::string& path, int m, int n, int tile, bool temporary = false);
+		~TiledMatrix();
+
+		TiledMatrix(const TiledMatrix&) = delete;
+		TiledMatrix& operator=(const TiledMatrix&) = delete;
+
+		static TiledMatrix temporary(int m, int n, int tile);
+		static int tileForBudget(size_t bytes, int n);
+
+		bool isOpen() const { return _file.is_open(); }
+		int rowCount() const { return _m; }
+		int colCount() const { return _n; }
+		int tile() const { return _tile; }
+		int tileRows() const { return (_m + _tile - 1) / _tile; }
+		int tileCols() const { return (_n + _tile - 1) / _tile; }
+		int tileHeight(int tj) const { return std::min(_tile, _m - tj * _tile); }
+		int tileWidth(int ti) const { return std::min(_tile, _n - ti * _tile); }
+
+		bool readTile(int tj, int ti, Matrix* tile) const;
+		bool writeTile(int tj, int ti, const Matrix& tile);
+
+		bool readColumnPanel(int ti, Matrix* panel) const;
+		bool writeColumnPanel(int ti, const Matrix& panel);
+
+		bool fill(const Matrix& A);
+		bool toMatrix(Matrix* A) const;
+	};
+
+	resultStatus outOfCoreMultiply(const TiledMatrix& A, const TiledMatrix& B, TiledMatrix& C);
+	resultStatus outOfCoreTranspose(const TiledMatrix& A, TiledMatrix& T);
+	resultStatus outOfCoreLU(TiledMatrix& A, std::vector<int>* pivots);
+	resultStatus outOfCoreLUSolve(const TiledMatrix& LU, const std::vector<int>& pivots, const Matrix b, Matrix* x);
+}
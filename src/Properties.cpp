@@ -1,4 +1,8 @@
 #include "Matrix.h"
+#include "Kernels.h"
+#include "Exact.h"
+
+#include <algorithm>
 
 /// <summary>
 /// Implementation of the property checking.
@@ -21,9 +25,12 @@ namespace als {
 		if (!isSquare()) return false;
 
 		for (int j = 1; j < _m; j++) {
+			const double* r = row(j);
+			bool nonZero = false;
 			for (int i = 0; i < j; i++) {
-				if ((*this)(j, i) != 0) return false;
+				nonZero |= (r[i] != 0);
 			}
+			if (nonZero) return false;
 		}
 
 		return true;
@@ -37,9 +44,12 @@ namespace als {
 		if (!isSquare()) return false;
 
 		for (int j = 0; j < _m; j++) {
-			for (int i = _n; i > j; i--) {
-				if ((*this)(j, i) != 0) return false;
+			const double* r = row(j);
+			bool nonZero = false;
+			for (int i = j + 1; i < _n; i++) {
+				nonZero |= (r[i] != 0);
 			}
+			if (nonZero) return false;
 		}
 		return true;
 	}
@@ -48,40 +58,85 @@ namespace als {
 	/**
 	* Check if the matrix is filled with zeros.
 	*/
-	bool Matrix::isNull() const { return rank() == 0; }
+	bool Matrix::isNull() const {
+		return std::all_of(data(), data() + _m * _n, [](double x) { return x == 0; });
+	}
 
 	/**
 	* Check if the matrix is an identity matrix.
 	*/
 	bool Matrix::isIdentity() const {
 
-		Matrix one(_m, _n);
+		if (!isSquare()) return false;
+
+		for (int j = 0; j < _m; j++) {
+			const double* r = row(j);
+			bool differs = false;
+			for (int i = 0; i < _n; i++) {
+				differs |= (r[i] != (i == j ? 1.0 : 0.0));
+			}
+			if (differs) return false;
+		}
+
+		return true;
+	}
+
+	/**
+	* Compare every element with its mirror, tile by tile so that the
+	* column strided side stays in cache. No transposed copy is built.
+	* @param sign 1 to check A^T == A, -1 for A^T == -A
+	*/
+	bool Matrix::mirrorsItself(double sign) const {
+
+		if (!isSquare()) return false;
+
+		const double* a = data();
+		const int tile = kernels::transposeTile;
+
+		for (int jj = 0; jj < _n; jj += tile) {
+			for (int ii = jj; ii < _n; ii += tile) {
+
+				bool differs = false;
 
-		for (int a = 0; a < _m * _n; a++) {
-			one(a) = 1;
+				for (int j = jj; j < std::min(jj + tile, _n); j++) {
+					for (int i = std::max(ii, j); i < std::min(ii + tile, _n); i++) {
+						differs |= (a[i * _n + j] != sign * a[j * _n + i]);
+					}
+				}
+
+				if (differs) return false;
+			}
 		}
 
-		return ((*this) * one) == one;
+		return true;
 	}
 
 	/**
 	* Check if the matrix is identical when transposed.
 	*/
 	bool Matrix::isSymetric() const {
-		return (transpose() == (*this));
+		return mirrorsItself(1);
 	}
 
 	/**
 	* Check if the matrix is its opposite when transposed.
 	*/
 	bool Matrix::isAntisymetric() const {
-		return (transpose() == ((*this) * -1));
+		return mirrorsItself(-1);
 	}
 
 	/**
-	* Check if the matrix is identical when squared.
+	* Check if the matrix is identical when squared. Integer matrices
+	* are squared exactly, a square that overflows can't be equal.
 	*/
 	bool Matrix::isIdempotent() const {
+
+		IntegerMatrix a, square;
+
+		if (IntegerMatrix::fromMatrix(*this, &a)) {
+			return a.multiply(a, &square) && square == a;
+		}
+
 		return (((*this) * (*this)) == (*this));
 	}
 
@@ -92,9 +147,20 @@ namespace als {
 	bool Matrix::isNilpotent(int level) const {
 		if (!isSquare()) return false;
 
-		Matrix nil(_m, _n);
+		// Exact powers of integer matrices, until they overflow
+		IntegerMatrix exact, next;
+
+		if (IntegerMatrix::fromMatrix(*this, &exact)) {
+			int l = 0;
+			for (; l < level - 1; l++) {
+				if (!exact.multiply(exact, &next)) break;
+				exact = next;
+				if (exact.isNull()) return true;
+			}
+			if (l == level - 1) return false;
+		}
 
-		nil.fill(_A.get());
+		Matrix nil = *this;
 
 		for (int l = 0; l < level - 1; l++) {
 			nil = nil * nil;
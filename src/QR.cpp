@@ -0,0 +1,350 @@
+#include "QR.h"
+#include "Instrumentation.h"
+#include "Kernels.h"
+#include "Reductions.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+/// <summary>
+/// Implementation of the Householder QR factorization.
+/// </summary>
+
+namespace als {
+
+	/**
+	* Factor the matrix with Householder reflections. With column pivoting
+	* the column of largest remaining norm is eliminated first, so the
+	* diagonal of R decreases and reveals the numerical rank. Without it the
+	* reflectors are applied by blocks in compact WY form.
+	* @param A matrix to factor (m x n)
+	* @param columnPivoting choose the columns by decreasing norm
+	*/
+	QRDecomposition::QRDecomposition(const Matrix A, bool columnPivoting)
+		: _QR(A.rowCount(), A.colCount()) {
+
+		ALS_PROFILE_SCOPE("QRDecomposition");
+
+		_QR.fill(A.data());
+		_tau.assign(std::min(A.rowCount(), A.colCount()), 0);
+		_colPerm.resize(A.colCount());
+
+		for (int i = 0; i < A.colCount(); i++) _colPerm[i] = i;
+
+		if (columnPivoting) factorPivoted();
+		else factorBlocked();
+	}
+
+	/**
+	* Generate the reflector of step k, zeroing the column below the diagonal.
+	* The vector is stored below the diagonal with an implicit leading 1.
+	*/
+	void QRDecomposition::makeReflector(int k) {
+
+		const int m = _QR.rowCount();
+		const Matrix::Writable qr = _QR.writable();
+
+		double alpha = qr(k, k);
+		double xNorm = 0;
+		for (int j = k + 1; j < m; j++) xNorm += qr(j, k) * qr(j, k);
+		xNorm = std::sqrt(xNorm);
+
+		if (xNorm == 0) {
+			_tau[k] = 0;
+			return;
+		}
+
+		double beta = -std::copysign(std::hypot(alpha, xNorm), alpha);
+		_tau[k] = (beta - alpha) / beta;
+		double scale = 1 / (alpha - beta);
+		for (int j = k + 1; j < m; j++) qr(j, k) *= scale;
+		qr(k, k) = beta;
+	}
+
+	/**
+	* Apply the reflector of step k to the columns [from, to).
+	* @param w workspace of at least `to` elements
+	*/
+	void QRDecomposition::applyReflector(int k, int from, int to, std::vector<double>& w) {
+
+		const int m = _QR.rowCount();
+		const double tau = _tau[k];
+
+		if (tau == 0 || from >= to) return;
+
+		ALS_COUNT_FLOPS(4ull * (m - k) * (to - from));
+
+		// w = v^T * A(k:m, from:to), accumulated row by row
+		std::copy(_QR.row(k) + from, _QR.row(k) + to, w.begin() + from);
+		for (int j = k + 1; j < m; j++) {
+			const double v = _QR(j, k);
+			const double* r = _QR.row(j);
+			for (int i = from; i < to; i++) w[i] += v * r[i];
+		}
+
+		// A -= tau * v * w^T
+		double* top = _QR.row(k);
+		for (int i = from; i < to; i++) top[i] -= tau * w[i];
+		for (int j = k + 1; j < m; j++) {
+			const double v = tau * _QR(j, k);
+			double* r = _QR.row(j);
+			for (int i = from; i < to; i++) r[i] -= v * w[i];
+		}
+	}
+
+	/**
+	* Unblocked factorization with column pivoting (Businger-Golub).
+	*/
+	void QRDecomposition::factorPivoted() {
+
+		const int m = _QR.rowCount();
+		const int n = _QR.colCount();
+		const int steps = static_cast<int>(_tau.size());
+
+		// Partial (vn1) and reference (vn2) norms of the remaining columns
+		std::vector<double> vn1(n, 0), vn2(n, 0), w(n);
+
+		for (int j = 0; j < m; j++) {
+			const double* r = _QR.row(j);
+			for (int i = 0; i < n; i++) vn1[i] += r[i] * r[i];
+		}
+		for (int i = 0; i < n; i++) vn2[i] = vn1[i] = std::sqrt(vn1[i]);
+
+		const double tol3z = std::sqrt(std::numeric_limits<double>::epsilon());
+
+		for (int k = 0; k < steps; k++) {
+
+			int p = static_cast<int>(std::max_element(vn1.begin() + k, vn1.end()) - vn1.begin());
+
+			if (p != k) {
+				for (int j = 0; j < m; j++) std::swap(_QR(j, k), _QR(j, p));
+				std::swap(_colPerm[k], _colPerm[p]);
+				std::swap(vn1[k], vn1[p]);
+				std::swap(vn2[k], vn2[p]);
+			}
+
+			makeReflector(k);
+			applyReflector(k, k + 1, n, w);
+
+			// Downdate the remaining column norms, recomputing the ones
+			// that lost too many digits to cancellation
+			for (int i = k + 1; i < n; i++) {
+
+				if (vn1[i] == 0) continue;
+
+				double ratio = std::abs(_QR(k, i)) / vn1[i];
+				double temp = std::max(0.0, 1 - ratio * ratio);
+				double temp2 = temp * (vn1[i] / vn2[i]) * (vn1[i] / vn2[i]);
+
+				if (temp2 <= tol3z) {
+					double norm = 0;
+					for (int j = k + 1; j < m; j++) norm += _QR(j, i) * _QR(j, i);
+					vn1[i] = vn2[i] = std::sqrt(norm);
+				}
+				else {
+					vn1[i] *= std::sqrt(temp);
+				}
+			}
+		}
+	}
+
+	/**
+	* Blocked factorization. Each panel of `block` columns is factored with
+	* level-2 updates, then its reflectors H1 ... Hb = I - V * T * V^T are
+	* applied to the trailing columns at once with three blocked products.
+	*/
+	void QRDecomposition::factorBlocked() {
+
+		const int m = _QR.rowCount();
+		const int n = _QR.colCount();
+		const int steps = static_cast<int>(_tau.size());
+
+		std::vector<double> w(n);
+
+		for (int k = 0; k < steps; k += block) {
+
+			const int nb = std::min(block, steps - k);
+			const int panelEnd = k + nb;
+
+			for (int p = k; p < panelEnd; p++) {
+				makeReflector(p);
+				applyReflector(p, p + 1, panelEnd, w);
+			}
+
+			if (panelEnd >= n) continue;
+
+			const int rows = m - k;
+			const int cols = n - panelEnd;
+
+			const Matrix::Writable qr = _QR.writable();
+			double* C = qr.row(k) + panelEnd;
+
+			// V^T with the implicit ones and zeros of V made explicit (nb x rows)
+			std::vector<double> Vt(nb * rows), V(rows * nb);
+			for (int r = 0; r < rows; r++) {
+				const double* src = qr.row(k + r) + k;
+				for (int c = 0; c < nb; c++) {
+					Vt[c * rows + r] = r > c ? src[c] : (r == c ? 1 : 0);
+				}
+			}
+			kernels::transpose(Vt.data(), nb, rows, rows, V.data(), nb);
+
+			// T(0:i, i) = -tau_i * T(0:i, 0:i) * V(:, 0:i)^T * v_i
+			std::vector<double> T(nb * nb, 0), z(nb);
+			for (int i = 0; i < nb; i++) {
+
+				const double tau = _tau[k + i];
+
+				const double* vi = Vt.data() + i * rows;
+				for (int j = 0; j < i; j++) z[j] = kernels::dot(rows - i, Vt.data() + j * rows + i, vi + i);
+
+				for (int j = 0; j < i; j++) {
+					double sum = 0;
+					for (int l = j; l < i; l++) sum += T[j * nb + l] * z[l];
+					T[j * nb + i] = -tau * sum;
+				}
+				T[i * nb + i] = tau;
+			}
+
+			ALS_COUNT_FLOPS(4ull * rows * nb * cols + 2ull * nb * nb * cols);
+
+			// -T^T, so that the last product accumulates into C
+			std::vector<double> Tt(nb * nb);
+			for (int j = 0; j < nb; j++) {
+				for (int i = 0; i < nb; i++) Tt[i * nb + j] = -T[j * nb + i];
+			}
+
+			// W = V^T * C, then Y = -T^T * W and C += V * Y
+			std::vector<double> W(nb * cols), Y(nb * cols);
+			kernels::gemm(nb, cols, rows, Vt.data(), rows, C, n, W.data(), cols);
+			kernels::gemm(nb, cols, nb, Tt.data(), nb, W.data(), cols, Y.data(), cols);
+			kernels::gemm(rows, cols, nb, V.data(), nb, Y.data(), cols, C, n, true);
+		}
+	}
+
+	/**
+	* Upper triangular factor (min(m, n) x n).
+	*/
+	Matrix QRDecomposition::R() const {
+
+		const int steps = static_cast<int>(_tau.size());
+		const int n = _QR.colCount();
+
+		Matrix r(steps, n);
+
+		for (int j = 0; j < steps; j++) {
+			double* dst = r.row(j);
+			const double* src = _QR.row(j);
+			for (int i = 0; i < n; i++) dst[i] = i < j ? 0 : src[i];
+		}
+
+		return r;
+	}
+
+	/**
+	* Tolerance under which a diagonal element of R is considered zero:
+	* max(m, n) * eps * |R(0, 0)|.
+	*/
+	double QRDecomposition::defaultTolerance() const {
+
+		if (_tau.empty()) return 0;
+
+		double largest = 0;
+		for (int k = 0; k < static_cast<int>(_tau.size()); k++) {
+			largest = std::max(largest, std::abs(_QR(k, k)));
+		}
+
+		return std::max(_QR.rowCount(), _QR.colCount())
+			* std::numeric_limits<double>::epsilon() * largest;
+	}
+
+	/**
+	* Numerical rank. Number of diagonal elements of R above the tolerance.
+	* Only reliable with column pivoting.
+	* @param tolerance absolute threshold, negative for defaultTolerance()
+	*/
+	int QRDecomposition::rank(double tolerance) const {
+
+		if (tolerance < 0) tolerance = defaultTolerance();
+
+		return reductions::countAbove(_QR.data(), static_cast<int>(_tau.size()), _QR.colCount() + 1, tolerance);
+	}
+
+	/**
+	* Apply Q^T to every column of b.
+	* @param b matrix with as many rows as A
+	* @return Q^T * b
+	*/
+	Matrix QRDecomposition::applyQTranspose(const Matrix b) const {
+
+		const int m = _QR.rowCount();
+		const int k = b.colCount();
+
+		Matrix c(m, k);
+		c.fill(b.data());
+
+		std::vector<double> w(k);
+
+		for (int s = 0; s < static_cast<int>(_tau.size()); s++) {
+
+			const double tau = _tau[s];
+			if (tau == 0) continue;
+
+			std::copy_n(c.row(s), k, w.begin());
+			for (int j = s + 1; j < m; j++) {
+				const double v = _QR(j, s);
+				const double* r = c.row(j);
+				for (int i = 0; i < k; i++) w[i] += v * r[i];
+			}
+
+			double* top = c.row(s);
+			for (int i = 0; i < k; i++) top[i] -= tau * w[i];
+			for (int j = s + 1; j < m; j++) {
+				const double v = tau * _QR(j, s);
+				double* r = c.row(j);
+				for (int i = 0; i < k; i++) r[i] -= v * w[i];
+			}
+		}
+
+		return c;
+	}
+
+	/**
+	* Least squares solution of A * x = b, minimizing ||A * x - b||.
+	* Rank deficient matrices get the basic solution, whose components
+	* beyond the numerical rank are zero.
+	* @param b right hand sides (m x k)
+	* @return x (n x k)
+	*/
+	Matrix QRDecomposition::solveLeastSquares(const Matrix b) const {
+
+		const int n = _QR.colCount();
+		const int k = b.colCount();
+		const int r = rank();
+
+		Matrix c = applyQTranspose(b);
+
+		// R(0:r, 0:r) * z = c(0:r)
+		for (int j = r - 1; j >= 0; j--) {
+			double* cj = c.row(j);
+			const double* u = _QR.row(j);
+			for (int l = j + 1; l < r; l++) {
+				const double* cl = c.row(l);
+				for (int i = 0; i < k; i++) cj[i] -= u[l] * cl[i];
+			}
+			for (int i = 0; i < k; i++) cj[i] /= u[j];
+		}
+
+		Matrix x(n, k);
+
+		for (int j = 0; j < n; j++) {
+			double* dst = x.row(_colPerm[j]);
+			if (j < r) std::copy_n(c.row(j), k, dst);
+			else std::fill_n(dst, k, 0.0);
+		}
+
+		return x;
+	}
+}
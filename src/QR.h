@@ -0,0 +1,40 @@
+#pragma once
+#include "Matrix.h"
+
+#include <vector>
+
+namespace als {
+
+	/**
+	* Householder QR factorization A * P = Q * R, optionally with column pivoting.
+	* The Householder vectors are stored below the diagonal of R.
+	*/
+	class QRDecomposition {
+
+		Matrix _QR;
+		std::vector<double> _tau;
+		std::vector<int> _colPerm;
+
+		void makeReflector(int k);
+		void applyReflector(int k, int from, int to, std::vector<double>& w);
+		void factorPivoted();
+		void factorBlocked();
+
+	public:
+
+		/// Panel width of the blocked factorization
+		static constexpr int block = 32;
+
+		QRDecomposition(const Matrix A, bool columnPivoting = true);
+
+		const Matrix& packed() const { return _QR; }
+		const std::vector<int>& colPermutation() const { return _colPerm; }
+
+		Matrix R() const;
+		double defaultTolerance() const;
+		int rank(double tolerance = -1) const;
+
+		Matrix applyQTranspose(const Matrix b) const;
+		Matrix solveLeastSquares(const Matrix b) const;
+	};
+}
@@ -0,0 +1,290 @@
+#include "Reductions.h"
+#include "Instrumentation.h"
+#include "Kernels.h"
+#include "QR.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+/// <summary>
+/// Implementation of the matrix reductions.
+/// </summary>
+
+namespace als::reductions {
+
+	namespace {
+
+		/**
+		* Sum of a short run with four independent accumulators.
+		*/
+		inline double blockSum(const double* x, int n) {
+
+			double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+			int i = 0;
+
+			for (; i + 4 <= n; i += 4) {
+				s0 += x[i];
+				s1 += x[i + 1];
+				s2 += x[i + 2];
+				s3 += x[i + 3];
+			}
+			for (; i < n; i++) s0 += x[i];
+
+			return (s0 + s1) + (s2 + s3);
+		}
+
+		inline double absSum(const double* x, int n) {
+
+			double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+			int i = 0;
+
+			for (; i + 4 <= n; i += 4) {
+				s0 += std::abs(x[i]);
+				s1 += std::abs(x[i + 1]);
+				s2 += std::abs(x[i + 2]);
+				s3 += std::abs(x[i + 3]);
+			}
+			for (; i < n; i++) s0 += std::abs(x[i]);
+
+			return (s0 + s1) + (s2 + s3);
+		}
+
+		/**
+		* Larger of a and b, NaN when either is NaN as in LAPACK dlange.
+		* std::max would drop a NaN in b.
+		*/
+		inline double nanMax(double a, double b) {
+			return (a < b || std::isnan(b)) ? b : a;
+		}
+
+		inline double absMax(const double* x, int n) {
+
+			double m0 = 0, m1 = 0, m2 = 0, m3 = 0;
+			int i = 0;
+
+			for (; i + 4 <= n; i += 4) {
+				m0 = nanMax(m0, std::abs(x[i]));
+				m1 = nanMax(m1, std::abs(x[i + 1]));
+				m2 = nanMax(m2, std::abs(x[i + 2]));
+				m3 = nanMax(m3, std::abs(x[i + 3]));
+			}
+			for (; i < n; i++) m0 = nanMax(m0, std::abs(x[i]));
+
+			return nanMax(nanMax(m0, m1), nanMax(m2, m3));
+		}
+
+		/**
+		* Sum of the (x / scale)^2.
+		*/
+		inline double scaledSquares(const double* x, int n, double scale) {
+
+			const double inverse = 1 / scale;
+			double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+			int i = 0;
+
+			for (; i + 4 <= n; i += 4) {
+				const double a = x[i] * inverse, b = x[i + 1] * inverse;
+				const double c = x[i + 2] * inverse, d = x[i + 3] * inverse;
+				s0 += a * a;
+				s1 += b * b;
+				s2 += c * c;
+				s3 += d * d;
+			}
+			for (; i < n; i++) s0 += (x[i] * inverse) * (x[i] * inverse);
+
+			return (s0 + s1) + (s2 + s3);
+		}
+
+		/**
+		* Rows per chunk of the parallel reductions, all the rows at once
+		* for the matrices under the threshold.
+		*/
+		int chunkRows(const Matrix& A) {
+
+			const long long elements = static_cast<long long>(A.rowCount()) * A.colCount();
+
+			if (elements < parallelThreshold) return std::max(1, A.rowCount());
+			return std::max(1, parallelGrain / std::max(1, A.colCount()));
+		}
+
+		/**
+		* Reduce every row chunk with partial(first, last) and return the
+		* partial results in row order.
+		*/
+		template <typename T, typename F>
+		std::vector<T> reduceRows(const Matrix& A, F&& partial) {
+
+			const int rows = chunkRows(A);
+			const int chunkCount = std::max(1, (A.rowCount() + rows - 1) / rows);
+
+			std::vector<T> partials(chunkCount);
+
+			kernels::parallelChunks(chunkCount, [&](int c) {
+				partials[c] = partial(c * rows, std::min(A.rowCount(), (c + 1) * rows));
+			});
+
+			return partials;
+		}
+
+		double maximum(const std::vector<double>& partials) {
+			double largest = 0;
+			for (double p : partials) largest = nanMax(largest, p);
+			return largest;
+		}
+	}
+
+	/**
+	* Pairwise summation down to leaves of pairwiseBlock elements.
+	*/
+	double sum(const double* x, int n) {
+
+		if (n <= pairwiseBlock) return blockSum(x, n);
+
+		// Split on a leaf boundary so the leaves stay full
+		const int half = (n / 2 + pairwiseBlock - 1) / pairwiseBlock * pairwiseBlock;
+
+		return sum(x, half) + sum(x + half, n - half);
+	}
+
+	double compensatedSum(const double* x, int n, int stride) {
+
+		double s = 0, compensation = 0;
+
+		for (int i = 0; i < n; i++) {
+
+			const double v = x[i * stride];
+			const double t = s + v;
+
+			// Recover the low order bits lost by the larger operand
+			if (std::abs(s) >= std::abs(v)) compensation += (s - t) + v;
+			else compensation += (v - t) + s;
+
+			s = t;
+		}
+
+		return s + compensation;
+	}
+
+	int countAbove(const double* x, int n, int stride, double tolerance) {
+
+		int count = 0;
+		for (int i = 0; i < n; i++) count += std::abs(x[i * stride]) > tolerance;
+
+		return count;
+	}
+
+	/**
+	* Sum of all the elements.
+	*/
+	double sum(const Matrix& A) {
+
+		ALS_PROFILE_SCOPE("reductions::sum");
+		ALS_COUNT_FLOPS(1ull * A.rowCount() * A.colCount());
+
+		std::vector<double> partials = reduceRows<double>(A, [&A](int first, int last) {
+			return sum(A.row(first), (last - first) * A.colCount());
+		});
+
+		return sum(partials.data(), static_cast<int>(partials.size()));
+	}
+
+	/**
+	* Compensated sum of the diagonal.
+	* @return trace, 0 if the matrix is not square
+	*/
+	double trace(const Matrix& A) {
+
+		if (!A.isSquare()) return 0;
+
+		return compensatedSum(A.data(), A.rowCount(), A.colCount() + 1);
+	}
+
+	/**
+	* Numerical rank, from a QR decomposition with column pivoting.
+	* @param tolerance magnitude under which a diagonal element of R is null,
+	* negative for max(m, n) * eps * |R(0, 0)|
+	*/
+	int rank(const Matrix& A, double tolerance) {
+		return QRDecomposition(A).rank(tolerance);
+	}
+
+	double maxNorm(const Matrix& A) {
+
+		ALS_PROFILE_SCOPE("reductions::maxNorm");
+
+		return maximum(reduceRows<double>(A, [&A](int first, int last) {
+			return absMax(A.row(first), (last - first) * A.colCount());
+		}));
+	}
+
+	/**
+	* Column sums accumulated row by row, so that the inner loop runs over
+	* contiguous elements.
+	*/
+	double norm1(const Matrix& A) {
+
+		ALS_PROFILE_SCOPE("reductions::norm1");
+		ALS_COUNT_FLOPS(1ull * A.rowCount() * A.colCount());
+
+		const int n = A.colCount();
+
+		std::vector<std::vector<double>> partials = reduceRows<std::vector<double>>(A, [&A, n](int first, int last) {
+			std::vector<double> columns(n, 0);
+			for (int j = first; j < last; j++) {
+				const double* r = A.row(j);
+				for (int i = 0; i < n; i++) columns[i] += std::abs(r[i]);
+			}
+			return columns;
+		});
+
+		std::vector<double>& columns = partials.front();
+		for (size_t c = 1; c < partials.size(); c++) {
+			for (int i = 0; i < n; i++) columns[i] += partials[c][i];
+		}
+
+		return maximum(columns);
+	}
+
+	double normInf(const Matrix& A) {
+
+		ALS_PROFILE_SCOPE("reductions::normInf");
+		ALS_COUNT_FLOPS(1ull * A.rowCount() * A.colCount());
+
+		return maximum(reduceRows<double>(A, [&A](int first, int last) {
+			double largest = 0;
+			for (int j = first; j < last; j++) largest = nanMax(largest, absSum(A.row(j), A.colCount()));
+			return largest;
+		}));
+	}
+
+	/**
+	* The squares are summed unscaled first. Only when they overflow or fall
+	* where the subnormals lose digits are they summed again relative to the
+	* largest magnitude.
+	*/
+	double frobeniusNorm(const Matrix& A) {
+
+		ALS_PROFILE_SCOPE("reductions::frobeniusNorm");
+		ALS_COUNT_FLOPS(2ull * A.rowCount() * A.colCount());
+
+		auto squares = [&A](double scale) {
+			std::vector<double> partials = reduceRows<double>(A, [&A, scale](int first, int last) {
+				return scaledSquares(A.row(first), (last - first) * A.colCount(), scale);
+			});
+			return sum(partials.data(), static_cast<int>(partials.size()));
+		};
+
+		const double plain = squares(1);
+
+		if (std::isfinite(plain) && plain >= std::numeric_limits<double>::min() / std::numeric_limits<double>::epsilon()) {
+			return std::sqrt(plain);
+		}
+
+		const double scale = maxNorm(A);
+		if (scale == 0 || !std::isfinite(scale)) return scale;
+
+		return scale * std::sqrt(squares(scale));
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "Matrix.h"
+
+/// <summary>
+/// Reductions of a whole matrix to a scalar. The inner loops keep several
+/// independent accumulators so that they vectorize, and the matrices past
+/// parallelThreshold elements are split by rows across threads. The chunks
+/// do not depend on the thread count, so the results are reproducible.
+/// </summary>
+
+namespace als::reductions {
+
+	/// Number of elements from which a reduction is split across threads.
+	constexpr int parallelThreshold = 1 << 18;
+
+	/// Elements summed by one thread chunk.
+	constexpr int parallelGrain = 1 << 15;
+
+	/// Length of the leaves of the pairwise summation.
+	constexpr int pairwiseBlock = 128;
+
+	/// Pairwise sum, with an error growing in O(log n) instead of O(n).
+	double sum(const double* x, int n);
+
+	/// Kahan-Babuska (Neumaier) compensated sum of x[0], x[stride], ...
+	double compensatedSum(const double* x, int n, int stride = 1);
+
+	/// Number of |x[0]|, |x[stride]|, ... strictly above the tolerance.
+	int countAbove(const double* x, int n, int stride, double tolerance);
+
+	double sum(const Matrix& A);
+	double trace(const Matrix& A);
+	int rank(const Matrix& A, double tolerance = -1);
+
+	/// max |a(j, i)|, NaN when an element is NaN
+	double maxNorm(const Matrix& A);
+	/// Largest absolute column sum, NaN when an element is NaN
+	double norm1(const Matrix& A);
+	/// Largest absolute row sum, NaN when an element is NaN
+	double normInf(const Matrix& A);
+	/// sqrt(sum a(j, i)^2), rescaled when the squares over or underflow
+	double frobeniusNorm(const Matrix& A);
+}
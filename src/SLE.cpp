@@ -1,4 +1,14 @@
 #include "Matrix.h"
+#include "Instrumentation.h"
+#include "QR.h"
+#include "Reductions.h"
+#include "Vector.h"
+#include "MixedPrecision.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
 
 /// <summary>
 /// Implementation of the system of linear equation 
@@ -13,8 +23,10 @@ namespace als {
 	* @param scalar factor
 	*/
 	void Matrix::scaleEquation(int equation, double scalar) {
+		ALS_COUNT_FLOPS(_n);
+		double* r = row(equation);
 		for (int i = 0; i < _n; i++) {
-			(*this)(equation, i) *= scalar;
+			r[i] *= scalar;
 		}
 	}
 
@@ -24,11 +36,8 @@ namespace als {
 	* @param equation2 second row
 	*/
 	void Matrix::swapEquations(int equation1, int equation2) {
-		for (int i = 0; i < _n; i++) {
-			double temp = (*this)(equation1, i);
-			(*this)(equation1, i) = (*this)(equation2, i);
-			(*this)(equation2, i) = temp;
-		}
+		ALS_COUNT_PIVOT();
+		std::swap_ranges(row(equation1), row(equation1) + _n, row(equation2));
 	}
 
 	/**
@@ -38,61 +47,81 @@ namespace als {
 	* @param scalar factor to apply to the second row
 	*/
 	void Matrix::addOtherEquation(int equation1, int equation2, double scalar) {
+		ALS_COUNT_FLOPS(2 * _n);
+		double* dst = row(equation1);
+		const double* src = row(equation2);
 		for (int i = 0; i < _n; i++) {
-			(*this)(equation1, i) += (*this)(equation2, i) * scalar;
+			dst[i] += src[i] * scalar;
 		}
 	}
 
 	/**
 	* Transform the SLE to an equivalent row echelon matrix.
-	* Uses the Gauss reduction algorithm.
+	* Uses the Gauss reduction algorithm with partial pivoting: the largest
+	* candidate of each column is the pivot, and columns whose candidates are
+	* all under the elimination tolerance are treated as null.
 	* @param b optional resultant vector
-	* @return factor between the determinant of the original matrix and its row echelon equivalent
+	* @param alpha optional, factor between the determinant of the original matrix and its row echelon equivalent
+	* @param pivots optional, receives the pivot column of each non-null row
 	*/
-	Matrix Matrix::toRowEchelon(const Matrix A, Matrix* b, double* alpha) {
+	Matrix Matrix::toRowEchelon(const Matrix A, Matrix* b, double* alpha, std::vector<int>* pivots) {
+
+		ALS_PROFILE_SCOPE("Matrix::toRowEchelon");
 
 		int equation = 0;
 
+		// Determinant factor as k * 2^kExponent, renormalized at every pivot
 		double k = 1;
+		int kExponent = 0;
 
 		Matrix ret = Matrix(A.rowCount(), A.colCount());
-		ret.fill(A._A.get());
+		ret.fill(A.data());
+
+		const double tolerance = eliminationTolerance(ret);
+		const Matrix::Writable element = ret.writable();
+
+		if (pivots) pivots->clear();
 
 		// Gauss Reduction
-		while (equation < ret.rowCount()) {
+		for (int column = 0; column < ret.colCount() && equation < ret.rowCount(); column++) {
 
-			if (ret(equation, equation) != 0) {
-				double scalar = 1 / ret(equation, equation);
-				ret.scaleEquation(equation, scalar);
-				if (b) b->scaleEquation(equation, scalar);
-				k /= scalar;
+			int pivot = equation;
 
-				for (int a = equation + 1; a < ret.colCount(); a++) {
-					double s = -ret(a, equation);
-					ret.addOtherEquation(a, equation, s);
-					if (b) b->addOtherEquation(a, equation, s);
-				}
+			for (int j = equation + 1; j < ret.rowCount(); j++) {
+				if (std::abs(element(j, column)) > std::abs(element(pivot, column))) pivot = j;
+			}
+
+			if (std::abs(element(pivot, column)) <= tolerance) {
+				// Numerically null column, flushed so that the rank reads exactly
+				for (int j = equation; j < ret.rowCount(); j++) element(j, column) = 0;
+				continue;
+			}
 
-				equation++;
+			if (pivot != equation) {
+				ret.swapEquations(equation, pivot);
+				if (b) b->swapEquations(equation, pivot);
+				k *= -1;
 			}
-			else {
-				if (equation + 1 != ret.rowCount()) {
-					if (ret(equation + 1, equation) != 0) {
-						ret.swapEquations(equation, equation + 1);
-						if (b) b->swapEquations(equation, equation + 1);
-						k *= -1;
-					}
-					else {
-						equation++;
-					}
-				}
-				else {
-					equation++;
-				}
+
+			double scalar = 1 / element(equation, column);
+			ret.scaleEquation(equation, scalar);
+			if (b) b->scaleEquation(equation, scalar);
+			int e;
+			k = std::frexp(k / scalar, &e);
+			kExponent += e;
+
+			for (int a = equation + 1; a < ret.rowCount(); a++) {
+				double s = -element(a, column);
+				ret.addOtherEquation(a, equation, s);
+				if (b) b->addOtherEquation(a, equation, s);
+				element(a, column) = 0;
 			}
+
+			if (pivots) pivots->push_back(column);
+			equation++;
 		}
 
-		if (alpha) *alpha = k;
+		if (alpha) *alpha = std::ldexp(k, kExponent);
 
 		return ret;
 	}
@@ -101,26 +130,48 @@ namespace als {
 	* Transform the SLE to an equivalent reduced row echelon matrix.
 	* Uses the Gauss-Jordan reduction algorithm.
 	* @param b optional resultant vector
+	* @param alpha optional, see toRowEchelon
+	* @param pivots optional, receives the pivot column of each non-null row
 	*/
-	Matrix Matrix::toReducedRowEchelon(const Matrix A, Matrix* b, double* alpha) {
+	Matrix Matrix::toReducedRowEchelon(const Matrix A, Matrix* b, double* alpha, std::vector<int>* pivots) {
 
-		Matrix ret = Matrix::toRowEchelon(A, b, alpha);
+		ALS_PROFILE_SCOPE("Matrix::toReducedRowEchelon");
 
-		// Gauss-Jordan Reduction
-		for (int equation = ret.rowCount() - 2; equation >= 0; equation--) {
+		std::vector<int> pivotColumns;
 
-			for (int j = equation + 1; j < ret.rowCount(); j++) {
+		Matrix ret = Matrix::toRowEchelon(A, b, alpha, &pivotColumns);
+		const Matrix::Writable element = ret.writable();
+
+		// Gauss-Jordan Reduction, the pivots are already scaled to 1
+		for (int equation = static_cast<int>(pivotColumns.size()) - 1; equation > 0; equation--) {
+
+			const int column = pivotColumns[equation];
 
-				double scalar = -ret(equation, j);
-				ret.addOtherEquation(equation, j, scalar);
+			for (int j = 0; j < equation; j++) {
 
-				if (b) b->addOtherEquation(equation, j, scalar);
+				double scalar = -element(j, column);
+				ret.addOtherEquation(j, equation, scalar);
+				element(j, column) = 0;
+
+				if (b) b->addOtherEquation(j, equation, scalar);
 			}
 		}
 
+		if (pivots) *pivots = std::move(pivotColumns);
+
 		return ret;
 	}
 
+	/**
+	* Elements under this magnitude are treated as zero during the elimination:
+	* max(m, n) * eps * ||A||_inf.
+	* @param A matrix to eliminate
+	*/
+	double Matrix::eliminationTolerance(const Matrix A) {
+
+		return std::max(A.rowCount(), A.colCount()) * std::numeric_limits<double>::epsilon() * reductions::normInf(A);
+	}
+
 	/**
 	* Construct an augmented matrix from an SLE.
 	* @param A factor part of the SLE
@@ -132,14 +183,100 @@ namespace als {
 		Matrix Ab(A.rowCount(), A.colCount() + 1);
 
 		for (int j = 0; j < A.rowCount(); j++) {
-			Ab(j, A.colCount()) = b(j, 0);
+			double* dst = Ab.row(j);
+			std::copy_n(A.row(j), A.colCount(), dst);
+			dst[A.colCount()] = b(j, 0);
+		}
+
+		return Ab;
+	}
+
+	/**
+	* Solve the system of linear equations without printing anything.
+	* The kind of solution is read from the reduced row echelon form: its
+	* pivots give the rank of A, and [A|b] has a larger rank when a null row
+	* of the reduced A has a non-null resultant.
+	* In mixed precision a square system is first solved by refining a single
+	* precision LU, and only goes through the elimination when the refinement
+	* does not reach a double precision backward error.
+	* @param A factors of the equations (m x n)
+	* @param b resultants of the equations (m x 1)
+	* @param precision DOUBLE elimination or MIXED precision refinement
+	* @return kind of solution, rank, determinant of a square A (NaN otherwise),
+	* every solution of a compatible system, reduced [A|b], residual of the
+	* particular solution in the infinity norm and its normwise backward error
+	*/
+	SleResult Matrix::solve(const Matrix A, const Matrix b, solvePrecision precision) {
+
+		ALS_PROFILE_SCOPE("Matrix::solveSLE");
 
-			for (int i = 0; i < A.colCount(); i++) {
-				Ab(j, i) = A(j, i);
+		const double notSquare = std::numeric_limits<double>::quiet_NaN();
+
+		if (A.rowCount() != b.rowCount() || b.colCount() != 1) {
+			return { resultStatus::SIZE_MISMATCH, sleSolution::NONE, 0, notSquare,
+				{ Matrix(1, 1), Matrix(1, 1), {}, {} }, Matrix(1, 1), 0, 0 };
+		}
+
+		if (precision == solvePrecision::MIXED && A.isSquare()) {
+
+			RefinedSolution refined = solveMixedPrecision(A, b);
+
+			if (refined.converged) {
+
+				const int n = A.rowCount();
+				std::vector<int> columns(n);
+				for (int i = 0; i < n; i++) columns[i] = i;
+
+				Vector r = Vector::fromMatrix(b);
+				gemv(1, A, Vector::fromMatrix(refined.x), -1, r);
+
+				// The reduced form of a regular system is [I|x]
+				return { resultStatus::OK, sleSolution::ONE, n, refined.determinant,
+					{ refined.x, Matrix(n, 0), columns, {} }, augmentedMatrix(Identity(n), refined.x),
+					r.normInf(), refined.backwardError };
 			}
 		}
 
-		return Ab;
+		const double tolerance = eliminationTolerance(augmentedMatrix(A, b));
+
+		Matrix reducedB = b;
+
+		double alpha = 0;
+		std::vector<int> pivots;
+		Matrix reduced = Matrix::toReducedRowEchelon(A, &reducedB, &alpha, &pivots);
+
+		const int aRank = static_cast<int>(pivots.size());
+		const double determinant = !A.isSquare() ? notSquare : (aRank == A.colCount() ? alpha : 0);
+
+		SleResult result = { resultStatus::OK, sleSolution::ONE, aRank, determinant,
+			generalSolution(reduced, reducedB, pivots), augmentedMatrix(reduced, reducedB), 0, 0 };
+
+		for (int j = aRank; j < reducedB.rowCount(); j++) {
+			if (std::abs(reducedB(j, 0)) > tolerance) result.kind = sleSolution::NONE;
+		}
+
+		if (result.kind != sleSolution::NONE && aRank < A.colCount()) {
+			result.kind = sleSolution::INFINITE;
+		}
+
+		// ||A * p - b||
+		Vector r = Vector::fromMatrix(b);
+		gemv(1, A, Vector::fromMatrix(result.general.particular), -1, r);
+		result.residual = r.normInf();
+
+		// ||A * p - b|| / (||A|| * ||p|| + ||b||)
+		const double scale = reductions::normInf(A) * reductions::maxNorm(result.general.particular) + reductions::maxNorm(b);
+		result.backwardError = scale > 0 ? result.residual / scale : result.residual;
+
+		return result;
+	}
+
+	/**
+	* Solve the system of linear equations without printing anything.
+	* @param b resultants of the equations (m elements)
+	*/
+	SleResult Matrix::solve(const Matrix A, const Vector& b, solvePrecision precision) {
+		return solve(A, b.toMatrix(), precision);
 	}
 
 	/**
@@ -148,51 +285,105 @@ namespace als {
 	* @param A factors of the equations.
 	* @param b resultants of the equations.
 	* @param x solution to the system if there is a single solution
+	* @param general optional, receives every solution of a compatible system
+	* @param status optional, receives SIZE_MISMATCH when the sizes don't match,
+	* so that it can be told apart from an incompatible system
 	* @return number of solutions (0, 1 or infinite)
 	*/
-	sleSolution Matrix::solveSLE(const Matrix A, Matrix b, Matrix* x) {
+	sleSolution Matrix::solveSLE(const Matrix A, Matrix b, Matrix* x, ParametricSolution* general,
+		resultStatus* status) {
 
-		if (A.rowCount() != b.rowCount() || A.colCount() != x->colCount()) {
+		if (status) *status = resultStatus::SIZE_MISMATCH;
+
+		if (A.colCount() != x->colCount() || A.rowCount() != b.rowCount() || b.colCount() != 1) {
 			std::cerr << "ERROR: The given SLE doesn't have proper sizes." << std::endl;
 			return sleSolution::NONE;
 		}
 
-		sleSolution ret;
+		SleResult result = solve(A, b);
 
-		Matrix::toReducedRowEchelon(A, &b);
+		if (status) *status = result.status;
 
-		Matrix Ab = augmentedMatrix(A, b);
+		if (result.kind == sleSolution::ONE) {
+			for (int resultant = 0; resultant < A.colCount(); resultant++) {
+				(*x)(0, resultant) = result.general.particular(resultant, 0);
+			}
+		}
 
-		int abRank = Ab.rank();
+		if (general && result.kind != sleSolution::NONE) *general = result.general;
 
-		if (abRank > A.rank()) {
-			ret = sleSolution::NONE;
+		return result.kind;
+	}
 
-			std::cout << "No solution to the SLE, it is incompatible." << std::endl;
-			Ab.print();
+	/**
+	* Build every solution of a compatible SLE from its reduced row echelon form,
+	* without any further elimination. The free variables are set to 0 in the
+	* particular solution, and each one gives a null space vector.
+	* @param reduced reduced row echelon form of A (m x n)
+	* @param reducedB resultants reduced along with A (m x 1)
+	* @param pivots pivot column of each non-null row of the reduced form
+	* @return particular solution (n x 1) and null space basis (n x (n - rank))
+	*/
+	ParametricSolution Matrix::generalSolution(const Matrix reduced, const Matrix reducedB,
+		const std::vector<int>& pivots) {
+
+		const int n = reduced.colCount();
+		const int rank = static_cast<int>(pivots.size());
+
+		std::vector<bool> isPivot(n, false);
+		for (int column : pivots) isPivot[column] = true;
+
+		std::vector<int> freeVariables;
+		for (int i = 0; i < n; i++) {
+			if (!isPivot[i]) freeVariables.push_back(i);
 		}
-		else {
 
-			if (abRank < A.colCount()) {
-				ret = sleSolution::INFINITE;
+		const int nullity = static_cast<int>(freeVariables.size());
 
-				std::cout << "Infinite solutions to the SLE: " << std::endl;
+		Matrix particular(n, 1);
+		std::fill_n(particular.data(), n, 0.0);
 
-				std::cout << "[A|b] = " << std::endl;
-				Ab.print();
-			}
-			else {
-				ret = sleSolution::ONE;
+		for (int j = 0; j < rank; j++) {
+			particular(pivots[j], 0) = reducedB(j, 0);
+		}
 
-				for (int resultant = 0; resultant < Ab.colCount(); resultant++) {
-					(*x)(0, resultant) = Ab(resultant, Ab.colCount() - 1);
-				}
+		// Column f: free variable f set to 1, the pivots compensate
+		Matrix nullSpace(n, nullity);
+		std::fill_n(nullSpace.data(), nullSpace.rowCount() * nullSpace.colCount(), 0.0);
 
-				std::cout << "Single solution to the SLE:" << std::endl;
-				x->print();
+		for (int f = 0; f < nullity; f++) {
+			nullSpace(freeVariables[f], f) = 1;
+			for (int j = 0; j < rank; j++) {
+				nullSpace(pivots[j], f) = -reduced(j, freeVariables[f]);
 			}
 		}
 
-		return ret;
+		return { particular, nullSpace, pivots, freeVariables };
+	}
+
+	/**
+	* Least squares solution of an overdetermined SLE, minimizing ||A * x - b||.
+	* Uses the blocked QR decomposition and only pays for column pivoting
+	* when A turns out to be rank deficient.
+	* @param A factors of the equations (m x n)
+	* @param b resultants of the equations (m x k)
+	* @return x (n x k)
+	*/
+	Matrix Matrix::leastSquares(const Matrix A, const Matrix b) {
+
+		ALS_PROFILE_SCOPE("Matrix::leastSquares");
+
+		if (A.rowCount() != b.rowCount()) {
+			std::cerr << "ERROR: The given SLE doesn't have proper sizes." << std::endl;
+			return Matrix(1, 1);
+		}
+
+		QRDecomposition qr(A, false);
+
+		if (A.rowCount() >= A.colCount() && qr.rank() == A.colCount()) {
+			return qr.solveLeastSquares(b);
+		}
+
+		return QRDecomposition(A).solveLeastSquares(b);
 	}
-}
\ No newline at end of file
+}
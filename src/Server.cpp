@@ -0,0 +1,725 @@
+#include "Server.h"
+#include "Matrix.h"
+#include "Instrumentation.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <afunix.h>
+#pragma comment(lib, "Ws2_32.lib")
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+/// <summary>
+/// Implementation of the server mode. One thread runs the event loop over
+/// the Unix domain socket: it accepts the clients, cuts the incoming bytes
+/// into frames and writes the responses back. The problems themselves are
+/// solved by a pool of workers, so a client can pipeline many requests and
+/// several clients are served at once. Responses carry the identifier of
+/// their request and may come back out of order.
+///
+/// Framing, little endian:
+///   request  = u32 length, u32 id, u8 opcode, u8[3] reserved, matrices
+///   response = u32 length, u32 id, u8 opcode, u8 status, u8[2] reserved, payload
+///   matrix   = i32 rows, i32 cols, rows * cols f64 row major
+/// The length counts the bytes after itself.
+/// </summary>
+
+namespace als {
+
+	namespace {
+
+#ifdef _WIN32
+		using socketHandle = SOCKET;
+		constexpr socketHandle invalidSocket = INVALID_SOCKET;
+		inline int pollSockets(WSAPOLLFD* fds, size_t count, int timeout) { return WSAPoll(fds, static_cast<ULONG>(count), timeout); }
+		inline void closeSocket(socketHandle s) { closesocket(s); }
+		inline bool wouldBlock() { return WSAGetLastError() == WSAEWOULDBLOCK; }
+		inline void setNonBlocking(socketHandle s) { u_long on = 1; ioctlsocket(s, FIONBIO, &on); }
+		using pollEntry = WSAPOLLFD;
+#else
+		using socketHandle = int;
+		constexpr socketHandle invalidSocket = -1;
+		inline int pollSockets(pollfd* fds, size_t count, int timeout) { return poll(fds, count, timeout); }
+		inline void closeSocket(socketHandle s) { close(s); }
+		inline bool wouldBlock() { return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR; }
+		inline void setNonBlocking(socketHandle s) { fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK); }
+		using pollEntry = pollfd;
+#endif
+
+		enum class opcode : uint8_t {
+			PROPERTIES = 1,
+			MULTIPLY,
+			SOLVE,
+			DETERMINANT,
+			INVERSE,
+			ADJUGATE,
+			STATISTICS,
+			SHUTDOWN,
+		};
+
+		constexpr int opcodeCount = static_cast<int>(opcode::SHUTDOWN) + 1;
+		constexpr uint8_t malformed = 0xFF;
+		constexpr uint32_t maxFrame = 1u << 30;
+		constexpr size_t headerSize = 12;
+
+		/// Set by the signal handlers and by the worker serving a shutdown request
+		std::atomic<bool> stopRequested{ false };
+		static_assert(std::atomic<bool>::is_always_lock_free, "stopRequested must be usable from a signal handler");
+
+		void requestStop(int) {
+			stopRequested.store(true);
+		}
+
+		const char* opcodeName(int op) {
+			static const char* names[] = { "?", "properties", "multiply", "solve", "determinant",
+				"inverse", "adjugate", "statistics", "shutdown" };
+			return op > 0 && op < opcodeCount ? names[op] : names[0];
+		}
+
+		/**
+		* Bounds checked reads from a request payload.
+		*/
+		class FrameReader {
+
+			const uint8_t* _data;
+			size_t _size, _position = 0;
+
+		public:
+
+			FrameReader(const uint8_t* data, size_t size) : _data(data), _size(size) {}
+
+			bool finished() const { return _position == _size; }
+
+			bool readI32(int32_t* value) {
+				if (_size - _position < sizeof(*value)) return false;
+				std::memcpy(value, _data + _position, sizeof(*value));
+				_position += sizeof(*value);
+				return true;
+			}
+
+			bool readMatrix(Matrix* A) {
+
+				int32_t rows, cols;
+				if (!readI32(&rows) || !readI32(&cols) || rows <= 0 || cols <= 0) return false;
+
+				const uint64_t bytes = static_cast<uint64_t>(rows) * cols * sizeof(double);
+				if (bytes > _size - _position) return false;
+
+				*A = Matrix(rows, cols);
+				std::memcpy(A->data(), _data + _position, bytes);
+				_position += bytes;
+
+				return true;
+			}
+		};
+
+		class FrameWriter {
+
+			std::vector<uint8_t> _bytes;
+
+		public:
+
+			FrameWriter(uint32_t id, uint8_t op, uint8_t status) : _bytes(headerSize, 0) {
+				std::memcpy(_bytes.data() + 4, &id, sizeof(id));
+				_bytes[8] = op;
+				_bytes[9] = status;
+			}
+
+			template <typename T>
+			void write(T value) {
+				const uint8_t* p = reinterpret_cast<const uint8_t*>(&value);
+				_bytes.insert(_bytes.end(), p, p + sizeof(T));
+			}
+
+			void writeMatrix(const Matrix& A) {
+				write<int32_t>(A.rowCount());
+				write<int32_t>(A.colCount());
+				const uint8_t* p = reinterpret_cast<const uint8_t*>(A.data());
+				_bytes.insert(_bytes.end(), p, p + sizeof(double) * A.rowCount() * A.colCount());
+			}
+
+			std::vector<uint8_t> finish() {
+				uint32_t length = static_cast<uint32_t>(_bytes.size() - 4);
+				std::memcpy(_bytes.data(), &length, sizeof(length));
+				return std::move(_bytes);
+			}
+		};
+
+		/**
+		* Latencies of the requests, from the arrival of the complete frame
+		* to the response being ready, by opcode. They are counted in fixed
+		* log-scale buckets, so that the memory stays constant however long
+		* the server runs; the percentiles are the upper edges of the buckets,
+		* at most 9% above the exact ones, and the maximum is exact.
+		*/
+		class LatencyStats {
+
+			/// Buckets per doubling, up to 2^octaves microseconds, under 1 us in the first
+			static constexpr int bucketsPerOctave = 8, octaves = 32;
+			static constexpr int bucketCount = bucketsPerOctave * octaves + 1;
+
+			struct Histogram {
+				uint64_t buckets[bucketCount] = {};
+				uint64_t count = 0;
+				double max = 0;
+			};
+
+			mutable std::mutex _mutex;
+			Histogram _histograms[opcodeCount];
+
+			static int bucket(double microseconds) {
+				if (!(microseconds >= 1)) return 0;
+				return std::min(bucketCount - 1, 1 + static_cast<int>(std::log2(microseconds) * bucketsPerOctave));
+			}
+
+			static double upperEdge(int b) {
+				return std::exp2(static_cast<double>(b) / bucketsPerOctave);
+			}
+
+		public:
+
+			void record(int op, double microseconds) {
+				std::lock_guard<std::mutex> lock(_mutex);
+				Histogram& histogram = _histograms[op];
+				histogram.buckets[bucket(microseconds)]++;
+				histogram.count++;
+				histogram.max = std::max(histogram.max, microseconds);
+			}
+
+			/**
+			* @param p percentile in [0, 100]
+			*/
+			static double percentile(const Histogram& histogram, double p) {
+
+				if (histogram.count == 0) return 0;
+
+				const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(p / 100 * histogram.count)));
+				uint64_t cumulative = 0;
+
+				for (int b = 0; b < bucketCount; b++) {
+					cumulative += histogram.buckets[b];
+					if (cumulative >= rank) return std::min(upperEdge(b), histogram.max);
+				}
+
+				return histogram.max;
+			}
+
+			/**
+			* Count, p50, p90, p99 and max of every opcode.
+			*/
+			void write(FrameWriter& out) const {
+				std::lock_guard<std::mutex> lock(_mutex);
+				for (int op = 1; op < opcodeCount; op++) {
+					out.write<uint32_t>(static_cast<uint32_t>(_histograms[op].count));
+					for (double p : { 50.0, 90.0, 99.0, 100.0 }) out.write<double>(percentile(_histograms[op], p));
+				}
+			}
+
+			void report(std::ostream& out) const {
+
+				std::lock_guard<std::mutex> lock(_mutex);
+
+				out << std::left << std::setw(14) << "request" << std::right
+					<< std::setw(10) << "count" << std::setw(12) << "p50 us"
+					<< std::setw(12) << "p90 us" << std::setw(12) << "p99 us" << std::setw(12) << "max us" << "\n";
+
+				for (int op = 1; op < opcodeCount; op++) {
+
+					const Histogram& histogram = _histograms[op];
+					if (histogram.count == 0) continue;
+
+					out << std::left << std::setw(14) << opcodeName(op) << std::right
+						<< std::setw(10) << histogram.count << std::fixed << std::setprecision(1);
+					for (double p : { 50.0, 90.0, 99.0, 100.0 }) out << std::setw(12) << percentile(histogram, p);
+					out << std::defaultfloat << "\n";
+				}
+			}
+		};
+
+		struct Job {
+			uint64_t connection;
+			uint32_t id;
+			uint8_t op;
+			std::vector<uint8_t> payload;
+			std::chrono::steady_clock::time_point received;
+		};
+
+		struct Response {
+			uint64_t connection;
+			std::vector<uint8_t> frame;
+		};
+
+		/**
+		* Bit i - 1 set for the property i of the property menu.
+		*/
+		uint32_t properties(const Matrix& A) {
+
+			// isNilpotent squares repeatedly, 2^(level - 1) >= n covers A^n
+			int level = 1;
+			while ((1 << (level - 1)) < A.rowCount()) level++;
+
+			bool checks[] = {
+				A.isSquare(), A.isUpperTriangular(), A.isLowerTriangular(), A.isDiagonal(),
+				A.isIdentity(), A.isNull(), A.isSymetric(), A.isAntisymetric(),
+				A.isSquare() && A.isIdempotent(), A.isNilpotent(level + 1), A.isInvertible(),
+			};
+
+			uint32_t mask = 0;
+			for (int p = 0; p < static_cast<int>(std::size(checks)); p++) mask |= uint32_t(checks[p]) << p;
+
+			return mask;
+		}
+
+		/**
+		* Solve the problem of a request and build its response frame.
+		*/
+		std::vector<uint8_t> handle(const Job& job, const LatencyStats& stats) {
+
+			FrameReader in(job.payload.data(), job.payload.size());
+			Matrix A(1, 1), B(1, 1);
+
+			auto fail = [&](uint8_t status) { return FrameWriter(job.id, job.op, status).finish(); };
+			auto ok = [&]() { return FrameWriter(job.id, job.op, static_cast<uint8_t>(resultStatus::OK)); };
+
+			switch (static_cast<opcode>(job.op)) {
+
+			case opcode::PROPERTIES: {
+				if (!in.readMatrix(&A) || !in.finished()) return fail(malformed);
+				FrameWriter out = ok();
+				out.write<uint32_t>(properties(A));
+				return out.finish();
+			}
+
+			case opcode::MULTIPLY: {
+				if (!in.readMatrix(&A) || !in.readMatrix(&B) || !in.finished()) return fail(malformed);
+				if (A.colCount() != B.rowCount()) return fail(static_cast<uint8_t>(resultStatus::SIZE_MISMATCH));
+				FrameWriter out = ok();
+				out.writeMatrix(A * B);
+				return out.finish();
+			}
+
+			case opcode::SOLVE: {
+				if (!in.readMatrix(&A) || !in.readMatrix(&B) || !in.finished()) return fail(malformed);
+				SleResult result = Matrix::solve(A, B);
+				if (result.status != resultStatus::OK) return fail(static_cast<uint8_t>(result.status));
+				FrameWriter out = ok();
+				out.write<uint8_t>(static_cast<uint8_t>(result.kind));
+				out.write<int32_t>(result.rank);
+				out.writeMatrix(result.general.particular);
+				out.writeMatrix(result.general.nullSpace);
+				return out.finish();
+			}
+
+			case opcode::DETERMINANT: {
+				if (!in.readMatrix(&A) || !in.finished()) return fail(malformed);
+				if (!A.isSquare()) return fail(static_cast<uint8_t>(resultStatus::NOT_SQUARE));
+				FrameWriter out = ok();
+				out.write<double>(Matrix::determinant(A));
+				return out.finish();
+			}
+
+			case opcode::INVERSE: {
+				if (!in.readMatrix(&A) || !in.finished()) return fail(malformed);
+				InverseResult result = Matrix::invert(A);
+				if (result.status != resultStatus::OK) return fail(static_cast<uint8_t>(result.status));
+				FrameWriter out = ok();
+				out.writeMatrix(result.inverse);
+				return out.finish();
+			}
+
+			case opcode::ADJUGATE: {
+				if (!in.readMatrix(&A) || !in.finished()) return fail(malformed);
+				if (!A.isSquare()) return fail(static_cast<uint8_t>(resultStatus::NOT_SQUARE));
+				FrameWriter out = ok();
+				out.writeMatrix(Matrix::adjugate(A));
+				return out.finish();
+			}
+
+			case opcode::STATISTICS: {
+				FrameWriter out = ok();
+				stats.write(out);
+				return out.finish();
+			}
+
+			case opcode::SHUTDOWN:
+				stopRequested.store(true);
+				return ok().finish();
+
+			default:
+				return fail(malformed);
+			}
+		}
+
+		struct Connection {
+			socketHandle socket;
+			std::vector<uint8_t> in, out;
+			int pending = 0;
+			bool readClosed = false;
+		};
+
+		/**
+		* Jobs waiting for a worker, and responses waiting for the event loop.
+		* The workers wake the loop through a pipe where there is one.
+		*/
+		class WorkQueue {
+
+			std::mutex _mutex;
+			std::condition_variable _available;
+			std::deque<Job> _jobs;
+			std::vector<Response> _done;
+			bool _closed = false;
+
+		public:
+
+			int wakeRead = -1, wakeWrite = -1;
+
+			void push(Job job) {
+				{
+					std::lock_guard<std::mutex> lock(_mutex);
+					_jobs.push_back(std::move(job));
+				}
+				_available.notify_one();
+			}
+
+			bool pop(Job* job) {
+				std::unique_lock<std::mutex> lock(_mutex);
+				_available.wait(lock, [this]() { return _closed || !_jobs.empty(); });
+				if (_jobs.empty()) return false;
+				*job = std::move(_jobs.front());
+				_jobs.pop_front();
+				return true;
+			}
+
+			void complete(Response response) {
+				{
+					std::lock_guard<std::mutex> lock(_mutex);
+					_done.push_back(std::move(response));
+				}
+#ifndef _WIN32
+				char byte = 0;
+				if (write(wakeWrite, &byte, 1) < 0) {}
+#endif
+			}
+
+			std::vector<Response> takeDone() {
+				std::lock_guard<std::mutex> lock(_mutex);
+				return std::exchange(_done, {});
+			}
+
+			void close() {
+				{
+					std::lock_guard<std::mutex> lock(_mutex);
+					_closed = true;
+				}
+				_available.notify_all();
+			}
+		};
+
+		void worker(WorkQueue& queue, LatencyStats& stats) {
+
+			Job job;
+
+			while (queue.pop(&job)) {
+
+				std::vector<uint8_t> frame;
+				{
+					ALS_PROFILE_SCOPE("server.request");
+					frame = handle(job, stats);
+				}
+
+				std::chrono::duration<double, std::micro> latency = std::chrono::steady_clock::now() - job.received;
+				if (job.op > 0 && job.op < opcodeCount) stats.record(job.op, latency.count());
+
+				queue.complete({ job.connection, std::move(frame) });
+			}
+		}
+
+		/**
+		* Cut the complete frames out of the input of a connection.
+		* @return false on a frame too large to be legitimate
+		*/
+		bool extractJobs(uint64_t id, Connection& connection, WorkQueue& queue) {
+
+			size_t offset = 0;
+
+			while (connection.in.size() - offset >= 4) {
+
+				uint32_t length;
+				std::memcpy(&length, connection.in.data() + offset, sizeof(length));
+
+				if (length > maxFrame || length < headerSize - 4) return false;
+				if (connection.in.size() - offset - 4 < length) break;
+
+				const uint8_t* frame = connection.in.data() + offset;
+				Job job;
+				job.connection = id;
+				std::memcpy(&job.id, frame + 4, sizeof(job.id));
+				job.op = frame[8];
+				job.payload.assign(frame + headerSize, frame + 4 + length);
+				job.received = std::chrono::steady_clock::now();
+
+				connection.pending++;
+				queue.push(std::move(job));
+
+				offset += 4 + length;
+			}
+
+			connection.in.erase(connection.in.begin(), connection.in.begin() + offset);
+
+			return true;
+		}
+
+		/**
+		* Remove the socket left at the path by a previous server. Any other
+		* kind of file is left alone.
+		* @return false if something other than a socket is at the path
+		*/
+		bool removeStaleSocket(const std::string& path) {
+#ifdef _WIN32
+			WIN32_FIND_DATAA found;
+			HANDLE search = FindFirstFileA(path.c_str(), &found);
+			if (search == INVALID_HANDLE_VALUE) return true;
+			FindClose(search);
+
+			// Windows Unix domain sockets are reparse points of their own tag
+			if (!(found.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) || found.dwReserved0 != IO_REPARSE_TAG_AF_UNIX) return false;
+
+			return DeleteFileA(path.c_str()) != 0;
+#else
+			struct stat status;
+			if (lstat(path.c_str(), &status) != 0) return errno == ENOENT;
+			if (!S_ISSOCK(status.st_mode)) return false;
+
+			return unlink(path.c_str()) == 0;
+#endif
+		}
+	}
+
+	/**
+	* Serve problems on a Unix domain socket until SIGINT, SIGTERM or a
+	* shutdown request, then report the latency percentiles.
+	* @param socketPath path of the socket, replacing a stale socket but no other file
+	* @param workerCount threads solving the problems, 0 for one per core
+	* @param log stream for the startup message and the report
+	* @return exit code
+	*/
+	int runServer(const std::string& socketPath, int workerCount, std::ostream& log) {
+
+#ifdef _WIN32
+		WSADATA wsaData;
+		if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+			std::cerr << "ERROR: Winsock could not be initialized.\n" << std::endl;
+			return 1;
+		}
+#else
+		std::signal(SIGPIPE, SIG_IGN);
+#endif
+		std::signal(SIGINT, requestStop);
+		std::signal(SIGTERM, requestStop);
+
+		sockaddr_un address = {};
+		address.sun_family = AF_UNIX;
+
+		if (socketPath.size() >= sizeof(address.sun_path)) {
+			std::cerr << "ERROR: The socket path is too long.\n" << std::endl;
+			return 1;
+		}
+		std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+		if (!removeStaleSocket(socketPath)) {
+			std::cerr << "ERROR: " << socketPath << " exists and is not a socket that can be replaced.\n" << std::endl;
+			return 1;
+		}
+
+		socketHandle listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+		if (listener == invalidSocket
+			|| bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+			|| listen(listener, SOMAXCONN) != 0) {
+			std::cerr << "ERROR: Could not listen on " << socketPath << ".\n" << std::endl;
+			if (listener != invalidSocket) closeSocket(listener);
+			return 1;
+		}
+
+		setNonBlocking(listener);
+
+		if (workerCount <= 0) workerCount = std::max(1u, std::thread::hardware_concurrency());
+
+		WorkQueue queue;
+		LatencyStats stats;
+
+#ifndef _WIN32
+		int wake[2];
+		if (pipe(wake) != 0) {
+			std::cerr << "ERROR: Could not create the wake pipe.\n" << std::endl;
+			closeSocket(listener);
+			return 1;
+		}
+		queue.wakeRead = wake[0];
+		queue.wakeWrite = wake[1];
+		fcntl(wake[0], F_SETFL, O_NONBLOCK);
+#endif
+
+		std::vector<std::thread> workers;
+		for (int w = 0; w < workerCount; w++) workers.emplace_back(worker, std::ref(queue), std::ref(stats));
+
+		log << "Serving on " << socketPath << " with " << workerCount << " workers" << std::endl;
+
+		std::map<uint64_t, Connection> connections;
+		uint64_t nextId = 0;
+		std::vector<pollEntry> fds;
+		std::vector<uint64_t> fdOwners;
+		uint8_t buffer[1 << 16];
+
+		while (!stopRequested.load()) {
+
+			fds.clear();
+			fdOwners.clear();
+
+			fds.push_back({ listener, POLLIN, 0 });
+#ifndef _WIN32
+			fds.push_back({ queue.wakeRead, POLLIN, 0 });
+#endif
+			const size_t firstClient = fds.size();
+
+			bool pending = false;
+			for (auto& [id, connection] : connections) {
+				short events = 0;
+				if (!connection.readClosed) events |= POLLIN;
+				if (!connection.out.empty()) events |= POLLOUT;
+				fds.push_back({ connection.socket, events, 0 });
+				fdOwners.push_back(id);
+				pending = pending || connection.pending > 0;
+			}
+
+#ifdef _WIN32
+			// No pipe for WSAPoll to watch, check the workers often while they are busy
+			const int timeout = pending ? 1 : 200;
+#else
+			const int timeout = 200;
+#endif
+
+			if (pollSockets(fds.data(), fds.size(), timeout) < 0) continue;
+
+			// New clients
+			if (fds[0].revents & POLLIN) {
+				socketHandle client;
+				while ((client = accept(listener, nullptr, nullptr)) != invalidSocket) {
+					setNonBlocking(client);
+					connections[nextId++] = Connection{ client, {}, {} };
+				}
+			}
+
+#ifndef _WIN32
+			if (fds[1].revents & POLLIN) {
+				while (read(queue.wakeRead, buffer, sizeof(buffer)) > 0) {}
+			}
+#endif
+
+			// Finished requests
+			for (Response& response : queue.takeDone()) {
+				auto found = connections.find(response.connection);
+				if (found == connections.end()) continue;
+				found->second.pending--;
+				found->second.out.insert(found->second.out.end(), response.frame.begin(), response.frame.end());
+			}
+
+			for (size_t f = firstClient; f < fds.size(); f++) {
+
+				auto found = connections.find(fdOwners[f - firstClient]);
+				Connection& connection = found->second;
+				bool broken = (fds[f].revents & (POLLERR | POLLNVAL)) != 0;
+
+				if (!broken && (fds[f].revents & (POLLIN | POLLHUP)) && !connection.readClosed) {
+					while (true) {
+						auto received = recv(connection.socket, reinterpret_cast<char*>(buffer), sizeof(buffer), 0);
+						if (received > 0) {
+							connection.in.insert(connection.in.end(), buffer, buffer + received);
+						}
+						else {
+							if (received == 0) connection.readClosed = true;
+							else if (!wouldBlock()) broken = true;
+							break;
+						}
+					}
+					broken = broken || !extractJobs(found->first, connection, queue);
+				}
+
+				if (!broken && !connection.out.empty()) {
+					while (!connection.out.empty()) {
+						auto sent = send(connection.socket, reinterpret_cast<const char*>(connection.out.data()),
+							static_cast<int>(std::min<size_t>(connection.out.size(), 1 << 20)), 0);
+						if (sent > 0) {
+							connection.out.erase(connection.out.begin(), connection.out.begin() + sent);
+						}
+						else {
+							broken = sent < 0 && !wouldBlock();
+							break;
+						}
+					}
+				}
+
+				// Closed once every pipelined request was answered
+				if (broken || (connection.readClosed && connection.pending == 0 && connection.out.empty())) {
+					closeSocket(connection.socket);
+					connections.erase(found);
+				}
+			}
+		}
+
+		queue.close();
+		for (std::thread& w : workers) w.join();
+
+		// Best effort delivery of the last responses, such as the shutdown acknowledgement
+		for (Response& response : queue.takeDone()) {
+			auto found = connections.find(response.connection);
+			if (found != connections.end()) found->second.out.insert(found->second.out.end(), response.frame.begin(), response.frame.end());
+		}
+
+		for (auto& [id, connection] : connections) {
+			if (!connection.out.empty()) {
+				send(connection.socket, reinterpret_cast<const char*>(connection.out.data()), static_cast<int>(connection.out.size()), 0);
+			}
+			closeSocket(connection.socket);
+		}
+		closeSocket(listener);
+
+		removeStaleSocket(socketPath);
+
+#ifdef _WIN32
+		WSACleanup();
+#else
+		close(wake[0]);
+		close(wake[1]);
+#endif
+
+		log << "\n--- Request latencies ---\n";
+		stats.report(log);
+
+		return 0;
+	}
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include <iosfwd>
+#include <string>
+
+namespace als {
+
+	int runServer(const std::string& socketPath, int workerCount, std::ostream& log);
+}
@@ -0,0 +1,562 @@
+#include "Spectral.h"
+#include "Instrumentation.h"
+#include "QR.h"
+#include "Kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <random>
+
+/// <summary>
+/// Implementation of the symmetric eigensolvers and of the SVD.
+/// </summary>
+
+namespace als {
+
+	namespace {
+
+		/**
+		* Householder reduction of a symmetric matrix to tridiagonal form
+		* T = Q^T * A * Q.
+		* @param a symmetric matrix, destroyed
+		* @param d diagonal of T
+		* @param e subdiagonal of T, e[i] = T(i + 1, i) and e[n - 1] = 0
+		* @param Q optional, receives the accumulated transformations
+		*/
+		void tridiagonalize(Matrix& a, std::vector<double>& d, std::vector<double>& e, Matrix* Q) {
+
+			const int n = a.rowCount();
+
+			d.assign(n, 0);
+			e.assign(n, 0);
+
+			std::vector<double> tau(n, 0), v(n), p(n);
+
+			for (int k = 0; k + 2 < n; k++) {
+
+				const int len = n - k - 1;
+				double* x = a.row(k) + k + 1;
+
+				double alpha = x[0];
+				double xNorm = 0;
+				for (int i = 1; i < len; i++) xNorm += x[i] * x[i];
+				xNorm = std::sqrt(xNorm);
+
+				if (xNorm == 0) {
+					e[k] = alpha;
+					continue;
+				}
+
+				double beta = -std::copysign(std::hypot(alpha, xNorm), alpha);
+				tau[k] = (beta - alpha) / beta;
+				e[k] = beta;
+
+				double scale = 1 / (alpha - beta);
+				v[0] = 1;
+				for (int i = 1; i < len; i++) v[i] = x[i] * scale;
+
+				ALS_COUNT_FLOPS(4ull * len * len);
+
+				// p = tau * A22 * v, then w = p - (tau / 2) * (p^T v) * v
+				double pv = 0;
+				for (int i = 0; i < len; i++) {
+					const double* r = a.row(k + 1 + i) + k + 1;
+					double sum = 0;
+					for (int j = 0; j < len; j++) sum += r[j] * v[j];
+					p[i] = tau[k] * sum;
+					pv += p[i] * v[i];
+				}
+				const double K = tau[k] * pv / 2;
+				for (int i = 0; i < len; i++) p[i] -= K * v[i];
+
+				// A22 -= v * w^T + w * v^T
+				for (int i = 0; i < len; i++) {
+					double* r = a.row(k + 1 + i) + k + 1;
+					const double vi = v[i], wi = p[i];
+					for (int j = 0; j < len; j++) r[j] -= vi * p[j] + wi * v[j];
+				}
+
+				// Row k is no longer needed, it keeps the reflector
+				for (int i = 1; i < len; i++) x[i] = v[i];
+			}
+
+			for (int i = 0; i < n; i++) d[i] = a(i, i);
+			if (n >= 2) e[n - 2] = a(n - 1, n - 2);
+
+			if (!Q) return;
+
+			*Q = Matrix::Identity(n);
+
+			// Q = H_0 * H_1 * ... accumulated from the last reflector
+			std::vector<double> w(n);
+
+			for (int k = n - 3; k >= 0; k--) {
+
+				if (tau[k] == 0) continue;
+
+				const int len = n - k - 1;
+				const double* x = a.row(k) + k + 1;
+
+				v[0] = 1;
+				for (int i = 1; i < len; i++) v[i] = x[i];
+
+				std::fill(w.begin(), w.end(), 0);
+				for (int i = 0; i < len; i++) {
+					const double* r = Q->row(k + 1 + i) + k + 1;
+					for (int j = 0; j < len; j++) w[j] += v[i] * r[j];
+				}
+				for (int i = 0; i < len; i++) {
+					double* r = Q->row(k + 1 + i) + k + 1;
+					const double tv = tau[k] * v[i];
+					for (int j = 0; j < len; j++) r[j] -= tv * w[j];
+				}
+			}
+		}
+
+		/**
+		* Eigenvalues of a symmetric tridiagonal matrix by the implicit QL
+		* algorithm with Wilkinson-like shifts.
+		* @param d diagonal, replaced by the eigenvalues
+		* @param e subdiagonal as produced by tridiagonalize, destroyed
+		* @param z optional, its columns are rotated into the eigenvectors
+		* @return false if an eigenvalue failed to converge
+		*/
+		bool tridiagonalQL(std::vector<double>& d, std::vector<double>& e, Matrix* z) {
+
+			const int n = static_cast<int>(d.size());
+			const double eps = std::numeric_limits<double>::epsilon();
+
+			for (int l = 0; l < n; l++) {
+
+				int iteration = 0;
+				int m;
+
+				do {
+					for (m = l; m < n - 1; m++) {
+						double dd = std::abs(d[m]) + std::abs(d[m + 1]);
+						if (std::abs(e[m]) <= eps * dd) break;
+					}
+
+					if (m == l) break;
+					if (iteration++ == 60) return false;
+
+					double g = (d[l + 1] - d[l]) / (2 * e[l]);
+					double r = std::hypot(g, 1.0);
+					g = d[m] - d[l] + e[l] / (g + std::copysign(r, g));
+
+					double s = 1, c = 1, p = 0;
+					int i;
+
+					for (i = m - 1; i >= l; i--) {
+
+						double f = s * e[i];
+						double b = c * e[i];
+						e[i + 1] = (r = std::hypot(f, g));
+
+						if (r == 0) {
+							d[i + 1] -= p;
+							e[m] = 0;
+							break;
+						}
+
+						s = f / r;
+						c = g / r;
+						g = d[i + 1] - p;
+						r = (d[i] - g) * s + 2 * c * b;
+						d[i + 1] = g + (p = s * r);
+						g = c * r - b;
+
+						if (z) {
+							for (int k = 0; k < z->rowCount(); k++) {
+								double* zk = z->row(k);
+								f = zk[i + 1];
+								zk[i + 1] = s * zk[i] + c * f;
+								zk[i] = c * zk[i] - s * f;
+							}
+						}
+					}
+
+					if (r == 0 && i >= l) continue;
+
+					d[l] -= p;
+					e[l] = g;
+					e[m] = 0;
+
+				} while (m != l);
+			}
+
+			return true;
+		}
+
+		/**
+		* Order of the values, ascending or descending.
+		*/
+		std::vector<int> sortedOrder(const std::vector<double>& values, bool descending) {
+
+			std::vector<int> order(values.size());
+			std::iota(order.begin(), order.end(), 0);
+
+			std::sort(order.begin(), order.end(), [&](int x, int y) {
+				return descending ? values[x] > values[y] : values[x] < values[y];
+			});
+
+			return order;
+		}
+
+		/**
+		* Lanczos iteration with full reorthogonalization for the k largest
+		* eigenvalues of a symmetric operator. The Krylov space grows until
+		* the Ritz pairs' residuals are small or it spans the whole space.
+		* @param apply y = A * x on vectors of size n
+		* @param vectors optional, receives the n x k Ritz vectors
+		* @return k largest eigenvalues, descending
+		*/
+		std::vector<double> lanczos(const std::function<void(const double*, double*)>& apply,
+			int n, int k, Matrix* vectors) {
+
+			std::mt19937 generator(12345);
+			std::uniform_real_distribution<double> distribution(-1, 1);
+
+			int steps = std::min(n, std::max(2 * k + 20, 40));
+
+			while (true) {
+
+				Matrix Q(steps + 1, n);
+				std::vector<double> alpha(steps, 0), beta(steps, 0);
+
+				auto orthogonalize = [&](double* w, int count) {
+					// Twice is enough (Kahan)
+					for (int pass = 0; pass < 2; pass++) {
+						for (int j = 0; j < count; j++) {
+							const double* q = Q.row(j);
+							kernels::axpy(n, -kernels::dot(n, q, w), q, w);
+						}
+					}
+				};
+
+				auto normalize = [&](double* w) {
+					const double norm = kernels::nrm2(n, w);
+					if (norm > 0) kernels::scal(n, 1 / norm, w);
+					return norm;
+				};
+
+				for (int i = 0; i < n; i++) Q(0, i) = distribution(generator);
+				normalize(Q.row(0));
+
+				for (int j = 0; j < steps; j++) {
+
+					double* w = Q.row(j + 1);
+					apply(Q.row(j), w);
+
+					alpha[j] = kernels::dot(n, Q.row(j), w);
+
+					orthogonalize(w, j + 1);
+					beta[j] = normalize(w);
+
+					// Invariant subspace found, continue from a fresh direction
+					if (beta[j] <= std::numeric_limits<double>::epsilon() * (std::abs(alpha[j]) + 1) && j + 1 < steps) {
+						beta[j] = 0;
+						for (int i = 0; i < n; i++) w[i] = distribution(generator);
+						orthogonalize(w, j + 1);
+						normalize(w);
+					}
+				}
+
+				std::vector<double> d = alpha, e = beta;
+				e[steps - 1] = 0;
+				Matrix S = Matrix::Identity(steps);
+
+				tridiagonalQL(d, e, &S);
+
+				std::vector<int> order = sortedOrder(d, true);
+				const int count = std::min(k, steps);
+
+				double scale = 0;
+				for (double value : d) scale = std::max(scale, std::abs(value));
+
+				// Residual of a Ritz pair is |beta_m * last component of its eigenvector|
+				bool converged = steps == n;
+				if (!converged) {
+					converged = true;
+					for (int c = 0; c < count; c++) {
+						double residual = std::abs(beta[steps - 1] * S(steps - 1, order[c]));
+						if (residual > 1e-10 * scale) converged = false;
+					}
+				}
+
+				if (!converged) {
+					steps = std::min(n, 2 * steps);
+					continue;
+				}
+
+				std::vector<double> values(count);
+				for (int c = 0; c < count; c++) values[c] = d[order[c]];
+
+				if (vectors) {
+					*vectors = Matrix(n, count);
+					std::fill_n(vectors->data(), n * count, 0.0);
+					for (int j = 0; j < steps; j++) {
+						const double* q = Q.row(j);
+						for (int c = 0; c < count; c++) {
+							const double s = S(j, order[c]);
+							for (int i = 0; i < n; i++) (*vectors)(i, c) += s * q[i];
+						}
+					}
+				}
+
+				return values;
+			}
+		}
+
+		/**
+		* One-sided Jacobi SVD of a matrix with at least as many rows as columns.
+		* Works on the rows of A^T so that every rotation is unit stride.
+		* @param Ut receives U^T (n x m) if not null
+		* @param Vt receives V^T (n x n) if not null
+		* @return singular values, unsorted
+		*/
+		std::vector<double> jacobiSVD(const Matrix& A, Matrix* Ut, Matrix* Vt) {
+
+			const int m = A.rowCount();
+			const int n = A.colCount();
+			const double eps = std::numeric_limits<double>::epsilon();
+
+			Matrix G = A.transpose();
+			if (Vt) *Vt = Matrix::Identity(n);
+
+			auto rotate = [](double* x, double* y, int length, double c, double s) {
+				for (int i = 0; i < length; i++) {
+					const double xi = x[i], yi = y[i];
+					x[i] = c * xi - s * yi;
+					y[i] = s * xi + c * yi;
+				}
+			};
+
+			for (int sweep = 0; sweep < 60; sweep++) {
+
+				bool rotated = false;
+
+				for (int p = 0; p < n - 1; p++) {
+					for (int q = p + 1; q < n; q++) {
+
+						const double* gp = G.row(p);
+						const double* gq = G.row(q);
+
+						double alpha = 0, beta = 0, gamma = 0;
+						for (int i = 0; i < m; i++) {
+							alpha += gp[i] * gp[i];
+							beta += gq[i] * gq[i];
+							gamma += gp[i] * gq[i];
+						}
+
+						if (std::abs(gamma) <= eps * std::sqrt(alpha * beta)) continue;
+
+						rotated = true;
+
+						double zeta = (beta - alpha) / (2 * gamma);
+						double t = std::copysign(1.0, zeta) / (std::abs(zeta) + std::sqrt(1 + zeta * zeta));
+						double c = 1 / std::sqrt(1 + t * t);
+						double s = c * t;
+
+						ALS_COUNT_FLOPS(12ull * m);
+
+						rotate(G.row(p), G.row(q), m, c, s);
+						if (Vt) rotate(Vt->row(p), Vt->row(q), n, c, s);
+					}
+				}
+
+				if (!rotated) break;
+			}
+
+			std::vector<double> values(n);
+
+			for (int i = 0; i < n; i++) {
+				double* g = G.row(i);
+				double norm = 0;
+				for (int j = 0; j < m; j++) norm += g[j] * g[j];
+				values[i] = std::sqrt(norm);
+				if (values[i] > 0) for (int j = 0; j < m; j++) g[j] /= values[i];
+			}
+
+			if (Ut) *Ut = G;
+
+			return values;
+		}
+	}
+
+	/**
+	* Eigen decomposition of a symmetric matrix: Householder tridiagonalization
+	* followed by the implicit QL algorithm. Only the upper triangle is trusted
+	* to be symmetric with the lower one, no check is done.
+	* @param A symmetric matrix
+	* @param computeVectors also accumulate the eigenvectors
+	* converged() is false when an eigenvalue failed to converge
+	*/
+	SymmetricEigenDecomposition::SymmetricEigenDecomposition(const Matrix A, bool computeVectors)
+		: _status(resultStatus::OK), _converged(true), _vectors(1, 1) {
+
+		ALS_PROFILE_SCOPE("SymmetricEigenDecomposition");
+
+		if (!A.isSquare()) {
+			_status = resultStatus::NOT_SQUARE;
+			return;
+		}
+
+		const int n = A.rowCount();
+
+		Matrix a(n, n);
+		a.fill(A.data());
+
+		std::vector<double> e;
+		Matrix Q(1, 1);
+
+		tridiagonalize(a, _values, e, computeVectors ? &Q : nullptr);
+
+		_converged = tridiagonalQL(_values, e, computeVectors ? &Q : nullptr);
+
+		std::vector<int> order = sortedOrder(_values, false);
+		std::vector<double> sorted(n);
+		for (int i = 0; i < n; i++) sorted[i] = _values[order[i]];
+		_values = sorted;
+
+		if (computeVectors) {
+			_vectors = Matrix(n, n);
+			const Matrix::Writable vectors = _vectors.writable();
+			for (int j = 0; j < n; j++) {
+				for (int i = 0; i < n; i++) vectors(j, i) = Q(j, order[i]);
+			}
+		}
+	}
+
+	/**
+	* The k largest eigenvalues of a symmetric matrix by the Lanczos method.
+	* Costs O(n^2) per iteration instead of O(n^3) for the full decomposition.
+	* @param A symmetric matrix
+	* @param k number of eigenvalues wanted
+	* @param computeVectors also compute the Ritz vectors
+	* @return decomposition holding the k eigenvalues in descending order
+	*/
+	SymmetricEigenDecomposition SymmetricEigenDecomposition::largest(const Matrix A, int k, bool computeVectors) {
+
+		ALS_PROFILE_SCOPE("SymmetricEigenDecomposition::largest");
+
+		SymmetricEigenDecomposition result;
+
+		if (!A.isSquare()) {
+			result._status = resultStatus::NOT_SQUARE;
+			return result;
+		}
+
+		const int n = A.rowCount();
+
+		auto apply = [&](const double* x, double* y) {
+			kernels::gemv(n, n, 1, A.data(), n, x, 0, y);
+		};
+
+		result._values = lanczos(apply, n, k, computeVectors ? &result._vectors : nullptr);
+
+		return result;
+	}
+
+	/**
+	* Thin SVD by one-sided Jacobi rotations, accurate for small singular values.
+	* When only the values are wanted of a tall matrix, the rotations run on the
+	* n x n triangular factor of its QR decomposition instead.
+	* @param A matrix to decompose (m x n)
+	* @param computeVectors also compute U (m x min(m, n)) and V (n x min(m, n))
+	*/
+	SingularValueDecomposition::SingularValueDecomposition(const Matrix A, bool computeVectors)
+		: _U(1, 1), _V(1, 1) {
+
+		ALS_PROFILE_SCOPE("SingularValueDecomposition");
+
+		// Decompose A^T when A is wide and swap the factors
+		const bool wide = A.rowCount() < A.colCount();
+		Matrix tall = wide ? A.transpose() : A;
+
+		Matrix Ut(1, 1), Vt(1, 1);
+		std::vector<double> values;
+
+		if (computeVectors) {
+			values = jacobiSVD(tall, &Ut, &Vt);
+		}
+		else if (tall.rowCount() > tall.colCount()) {
+			values = jacobiSVD(QRDecomposition(tall, false).R(), nullptr, nullptr);
+		}
+		else {
+			values = jacobiSVD(tall, nullptr, nullptr);
+		}
+
+		std::vector<int> order = sortedOrder(values, true);
+		const int r = static_cast<int>(values.size());
+
+		_values.resize(r);
+		for (int i = 0; i < r; i++) _values[i] = values[order[i]];
+
+		if (!computeVectors) return;
+
+		// Columns of U and V are the sorted rows of Ut and Vt
+		Matrix U(Ut.colCount(), r), V(Vt.colCount(), r);
+		const Matrix::Writable uColumns = U.writable(), vColumns = V.writable();
+
+		for (int c = 0; c < r; c++) {
+			const double* u = Ut.row(order[c]);
+			const double* v = Vt.row(order[c]);
+			for (int j = 0; j < U.rowCount(); j++) uColumns(j, c) = u[j];
+			for (int j = 0; j < V.rowCount(); j++) vColumns(j, c) = v[j];
+		}
+
+		_U = wide ? V : U;
+		_V = wide ? U : V;
+	}
+
+	/**
+	* The k largest singular values and their vectors, by the Lanczos method
+	* on A^T * A without forming it.
+	* @param A matrix (m x n)
+	* @param k number of singular values wanted
+	*/
+	SingularValueDecomposition SingularValueDecomposition::largest(const Matrix A, int k) {
+
+		ALS_PROFILE_SCOPE("SingularValueDecomposition::largest");
+
+		const int m = A.rowCount();
+		const int n = A.colCount();
+
+		std::vector<double> t(m);
+
+		auto apply = [&](const double* x, double* y) {
+			kernels::gemv(m, n, 1, A.data(), n, x, 0, t.data());
+			kernels::gemvTransposed(m, n, 1, A.data(), n, t.data(), 0, y);
+		};
+
+		SingularValueDecomposition result;
+		std::vector<double> squares = lanczos(apply, n, std::min(k, std::min(m, n)), &result._V);
+
+		result._values.resize(squares.size());
+		for (size_t i = 0; i < squares.size(); i++) result._values[i] = std::sqrt(std::max(0.0, squares[i]));
+
+		// u = A * v / sigma
+		result._U = A * result._V;
+		const Matrix::Writable u = result._U.writable();
+		for (int c = 0; c < result._U.colCount(); c++) {
+			const double sigma = result._values[c];
+			for (int j = 0; j < m; j++) u(j, c) = sigma > 0 ? u(j, c) / sigma : 0;
+		}
+
+		return result;
+	}
+
+	/**
+	* 2-norm condition number, ratio of the extreme singular values.
+	*/
+	double SingularValueDecomposition::conditionNumber() const {
+
+		if (_values.empty() || _values.back() == 0) return std::numeric_limits<double>::infinity();
+
+		return _values.front() / _values.back();
+	}
+}
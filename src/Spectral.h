@@ -0,0 +1,56 @@
+#pragma once
+#include "Matrix.h"
+
+#include <vector>
+
+namespace als {
+
+	/**
+	* Eigen decomposition A = V * diag(values) * V^T of a symmetric matrix.
+	* Eigenvalues are in ascending order, the eigenvectors are the columns of V.
+	* status() is NOT_SQUARE, with no eigenvalue, when A is not square.
+	*/
+	class SymmetricEigenDecomposition {
+
+		resultStatus _status;
+		bool _converged;
+		std::vector<double> _values;
+		Matrix _vectors;
+
+		SymmetricEigenDecomposition() : _status(resultStatus::OK), _converged(true), _vectors(1, 1) {}
+
+	public:
+
+		SymmetricEigenDecomposition(const Matrix A, bool computeVectors = true);
+		static SymmetricEigenDecomposition largest(const Matrix A, int k, bool computeVectors = true);
+
+		resultStatus status() const { return _status; }
+		bool converged() const { return _converged; }
+		const std::vector<double>& values() const { return _values; }
+		const Matrix& vectors() const { return _vectors; }
+	};
+
+	/**
+	* Singular value decomposition A = U * diag(values) * V^T.
+	* Singular values are in descending order.
+	*/
+	class SingularValueDecomposition {
+
+		std::vector<double> _values;
+		Matrix _U, _V;
+
+		SingularValueDecomposition() : _U(1, 1), _V(1, 1) {}
+
+	public:
+
+		SingularValueDecomposition(const Matrix A, bool computeVectors = true);
+		static SingularValueDecomposition largest(const Matrix A, int k);
+
+		const std::vector<double>& values() const { return _values; }
+		const Matrix& U() const { return _U; }
+		const Matrix& V() const { return _V; }
+
+		double norm2() const { return _values.empty() ? 0 : _values.front(); }
+		double conditionNumber() const;
+	};
+}
@@ -0,0 +1,169 @@
+#include "Kernels.h"
+
+#include <algorithm>
+#include <vector>
+
+/// <summary>
+/// Implementation of the Strassen-Winograd product. Each level does 7 half
+/// size products and 15 additions instead of 8 products, with a schedule
+/// that only needs two temporaries besides the quadrants of C.
+/// </summary>
+
+namespace als::kernels {
+
+	namespace {
+
+		/// Matrix view on row major storage
+		struct Block {
+			double* data;
+			int ld;
+
+			double* row(int j) const { return data + j * ld; }
+			Block quadrant(int j, int i, int rows, int cols) const { return { data + j * rows * ld + i * cols, ld }; }
+		};
+
+		struct ConstBlock {
+			const double* data;
+			int ld;
+
+			const double* row(int j) const { return data + j * ld; }
+			ConstBlock quadrant(int j, int i, int rows, int cols) const { return { data + j * rows * ld + i * cols, ld }; }
+		};
+
+		void add(int m, int n, ConstBlock x, ConstBlock y, Block z) {
+			for (int j = 0; j < m; j++) {
+				const double* xj = x.row(j);
+				const double* yj = y.row(j);
+				double* zj = z.row(j);
+				for (int i = 0; i < n; i++) zj[i] = xj[i] + yj[i];
+			}
+		}
+
+		void sub(int m, int n, ConstBlock x, ConstBlock y, Block z) {
+			for (int j = 0; j < m; j++) {
+				const double* xj = x.row(j);
+				const double* yj = y.row(j);
+				double* zj = z.row(j);
+				for (int i = 0; i < n; i++) zj[i] = xj[i] - yj[i];
+			}
+		}
+
+		ConstBlock view(Block b) {
+			return { b.data, b.ld };
+		}
+
+		/**
+		* Workspace needed by a product of these even dimensions and its recursion.
+		*/
+		size_t workspaceSize(int m, int n, int k, int crossover) {
+
+			size_t total = 0;
+
+			while (std::min({ m, n, k }) >= crossover) {
+				m /= 2;
+				n /= 2;
+				k /= 2;
+				total += static_cast<size_t>(m) * std::max(n, k) + static_cast<size_t>(k) * n;
+				m &= ~1;
+				n &= ~1;
+				k &= ~1;
+			}
+
+			return total;
+		}
+
+		void multiply(int m, int n, int k, ConstBlock A, ConstBlock B, Block C, double* workspace, int crossover);
+
+		/**
+		* Product of dimensions that are all even, split in quadrants.
+		* Schedule of Boyer, Dumas, Pernet and Zhou for C = A * B.
+		*/
+		void winograd(int m, int n, int k, ConstBlock A, ConstBlock B, Block C, double* workspace, int crossover) {
+
+			const int hm = m / 2, hn = n / 2, hk = k / 2;
+
+			ConstBlock A11 = A.quadrant(0, 0, hm, hk), A12 = A.quadrant(0, 1, hm, hk);
+			ConstBlock A21 = A.quadrant(1, 0, hm, hk), A22 = A.quadrant(1, 1, hm, hk);
+			ConstBlock B11 = B.quadrant(0, 0, hk, hn), B12 = B.quadrant(0, 1, hk, hn);
+			ConstBlock B21 = B.quadrant(1, 0, hk, hn), B22 = B.quadrant(1, 1, hk, hn);
+			Block C11 = C.quadrant(0, 0, hm, hn), C12 = C.quadrant(0, 1, hm, hn);
+			Block C21 = C.quadrant(1, 0, hm, hn), C22 = C.quadrant(1, 1, hm, hn);
+
+			// X holds a hm x hk operand or the hm x hn product P1, Y a hk x hn operand
+			const int ldx = std::max(hn, hk);
+			Block X = { workspace, ldx };
+			Block Y = { workspace + static_cast<size_t>(hm) * ldx, hn };
+			double* deeper = Y.data + static_cast<size_t>(hk) * hn;
+
+			sub(hm, hk, A11, A21, X);								// S3
+			sub(hk, hn, B22, B12, Y);								// T3
+			multiply(hm, hn, hk, view(X), view(Y), C21, deeper, crossover);	// P7
+
+			add(hm, hk, A21, A22, X);								// S1
+			sub(hk, hn, B12, B11, Y);								// T1
+			multiply(hm, hn, hk, view(X), view(Y), C22, deeper, crossover);	// P5
+
+			sub(hm, hk, view(X), A11, X);							// S2
+			sub(hk, hn, B22, view(Y), Y);							// T2
+			multiply(hm, hn, hk, view(X), view(Y), C12, deeper, crossover);	// P6
+
+			sub(hm, hk, A12, view(X), X);							// S4
+			multiply(hm, hn, hk, view(X), B22, C11, deeper, crossover);		// P3
+
+			multiply(hm, hn, hk, A11, B11, X, deeper, crossover);	// P1
+
+			add(hm, hn, view(X), view(C12), C12);					// U2 = P1 + P6
+			add(hm, hn, view(C12), view(C21), C21);					// U3 = U2 + P7
+			add(hm, hn, view(C12), view(C22), C12);					// U4 = U2 + P5
+			add(hm, hn, view(C21), view(C22), C22);					// U7 = U3 + P5
+			add(hm, hn, view(C12), view(C11), C12);					// U5 = U4 + P3
+
+			sub(hk, hn, view(Y), B21, Y);							// T4
+			multiply(hm, hn, hk, A22, view(Y), C11, deeper, crossover);		// P4
+			sub(hm, hn, view(C21), view(C11), C21);					// U6 = U3 - P4
+
+			multiply(hm, hn, hk, A12, B21, C11, deeper, crossover);	// P2
+			add(hm, hn, view(X), view(C11), C11);					// U1 = P1 + P2
+		}
+
+		/**
+		* Recurse on the even part of the dimensions and peel the odd last
+		* row, column or inner index with the blocked product.
+		*/
+		void multiply(int m, int n, int k, ConstBlock A, ConstBlock B, Block C, double* workspace, int crossover) {
+
+			const int em = m & ~1, en = n & ~1, ek = k & ~1;
+
+			if (std::min({ em, en, ek }) < crossover) {
+				gemm(m, n, k, A.data, A.ld, B.data, B.ld, C.data, C.ld);
+				return;
+			}
+
+			winograd(em, en, ek, A, B, C, workspace, crossover);
+
+			// Last inner index: C(0:em, 0:en) += A(0:em, ek) * B(ek, 0:en)
+			if (ek < k) gemm(em, en, 1, A.data + ek, A.ld, B.row(ek), B.ld, C.data, C.ld, true);
+
+			// Last column and last row of C, over the whole inner dimension
+			if (en < n) gemm(m, 1, k, A.data, A.ld, B.data + en, B.ld, C.data + en, C.ld);
+			if (em < m) gemm(1, en, k, A.row(em), A.ld, B.data, B.ld, C.row(em), C.ld);
+		}
+	}
+
+	/**
+	* C = A * B with Strassen-Winograd. The temporaries of every level are
+	* carved from a single workspace allocated once for the whole recursion.
+	*/
+	void strassen(int m, int n, int k, const double* a, int lda, const double* b, int ldb,
+		double* c, int ldc, int crossover) {
+
+		if (crossover <= 0) crossover = strassenCrossover;
+
+		// Every split needs both halves non empty
+		crossover = std::max(crossover, 2);
+
+		std::vector<double> workspace(workspaceSize(m & ~1, n & ~1, k & ~1, crossover));
+
+		multiply(m, n, k, { a, lda }, { b, ldb }, { c, ldc }, workspace.data(), crossover);
+	}
+}
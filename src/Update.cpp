@@ -0,0 +1,313 @@
+#include "Update.h"
+#include "LU.h"
+#include "Reductions.h"
+#include "Vector.h"
+#include "Kernels.h"
+#include "Instrumentation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+/// <summary>
+/// Implementation of the Sherman-Morrison-Woodbury updates of an inverse.
+/// </summary>
+
+namespace als {
+
+	namespace {
+
+		/**
+		* y = A * x for an n x k block x, a single column going through gemv.
+		*/
+		Matrix multiply(const Matrix& A, const Matrix& x) {
+
+			const int n = A.rowCount();
+			const int k = x.colCount();
+
+			Matrix y(n, k);
+
+			if (k == 1) {
+				kernels::gemv(n, A.colCount(), 1, A.data(), A.colCount(), x.data(), 0, y.data());
+				return y;
+			}
+
+			for (int j = 0; j < n; j++) {
+				const double* a = A.row(j);
+				double* yj = y.row(j);
+				std::fill_n(yj, k, 0.0);
+				for (int l = 0; l < A.colCount(); l++) {
+					const double* xl = x.row(l);
+					for (int c = 0; c < k; c++) yj[c] += a[l] * xl[c];
+				}
+			}
+
+			return y;
+		}
+
+		/**
+		* y = A^T * x for an n x k block x, a single column going through gemv.
+		*/
+		Matrix multiplyTransposed(const Matrix& A, const Matrix& x) {
+
+			const int n = A.colCount();
+			const int k = x.colCount();
+
+			Matrix y(n, k);
+
+			if (k == 1) {
+				kernels::gemvTransposed(A.rowCount(), n, 1, A.data(), n, x.data(), 0, y.data());
+				return y;
+			}
+			for (int a = 0; a < n * k; a++) y(a) = 0;
+
+			for (int j = 0; j < A.rowCount(); j++) {
+				const double* a = A.row(j);
+				const double* xj = x.row(j);
+				for (int l = 0; l < n; l++) {
+					double* yl = y.row(l);
+					for (int c = 0; c < k; c++) yl[c] += a[l] * xj[c];
+				}
+			}
+
+			return y;
+		}
+	}
+
+	/**
+	* Invert the matrix and prepare it for updates.
+	* @param A square matrix
+	* @param refactorInterval number of updates after which the inverse is
+	* recomputed no matter what, 0 to only rely on the accuracy check
+	* @param tolerance backward error of the probe solve over which the inverse
+	* is recomputed, negative for sqrt(eps)
+	* status() is NOT_SQUARE when A is not square, SINGULAR when it can't be inverted
+	*/
+	UpdatableInverse::UpdatableInverse(const Matrix A, int refactorInterval, double tolerance)
+		: _A(A), _inverse(A.rowCount(), A.colCount()), _determinant(0),
+		_tolerance(tolerance < 0 ? std::sqrt(std::numeric_limits<double>::epsilon()) : tolerance),
+		_refactorInterval(refactorInterval), _updates(0), _refactorizations(0), _singular(true) {
+
+		if (A.isSquare()) refactor();
+	}
+
+	/**
+	* Recompute the inverse and the determinant from scratch.
+	*/
+	void UpdatableInverse::refactor() {
+
+		ALS_PROFILE_SCOPE("UpdatableInverse::refactor");
+
+		LUDecomposition lu(_A);
+
+		_determinant = lu.determinant();
+		_singular = lu.isSingular();
+		_updates = 0;
+		_refactorizations++;
+
+		if (!_singular) _inverse = lu.solve(Matrix::Identity(_A.rowCount()));
+	}
+
+	/**
+	* Backward error of the solve of A * x = 1 through the current inverse,
+	* ||A * x - 1|| / (||A|| * ||x|| + 1) in the infinity norm. O(n^2).
+	* @param residual optional, receives ||A * x - 1||
+	*/
+	double UpdatableInverse::probeError(double* residual) const {
+
+		const int n = _A.rowCount();
+
+		Vector ones(n, 1);
+
+		Vector x = gemv(_inverse, ones);
+		Vector r = ones;
+		gemv(1, _A, x, -1, r);
+
+		if (residual) *residual = r.normInf();
+
+		return r.normInf() / (reductions::normInf(_A) * x.normInf() + 1);
+	}
+
+	/**
+	* Refactor when the interval is reached or when the probe shows that the
+	* updates lost too much accuracy. A matrix made singular can keep a small
+	* backward error with a huge inverse, but its residual stays of the order
+	* of the probe, and the factorization then decides.
+	*/
+	void UpdatableInverse::checkAccuracy() {
+
+		_updates++;
+
+		double residual;
+		const double error = probeError(&residual);
+
+		if ((_refactorInterval > 0 && _updates >= _refactorInterval) || !(error <= _tolerance) || !(residual < 0.5)) {
+			refactor();
+		}
+	}
+
+	/**
+	* Apply A^-1 <- A^-1 - A^-1 * U * C^-1 * V^T * A^-1 with the capacitance
+	* matrix C = I + V^T * A^-1 * U, after A has already been changed.
+	* @return false when C is too close to singular for the update to be trusted
+	*/
+	bool UpdatableInverse::applyWoodbury(const Matrix& U, const Matrix& V) {
+
+		const int n = _A.rowCount();
+		const int k = U.colCount();
+
+		Matrix W = multiply(_inverse, U);				// A^-1 * U (n x k)
+		Matrix Z = multiplyTransposed(_inverse, V);		// A^-T * V (n x k)
+
+		Matrix C = multiplyTransposed(V, W);
+		for (int c = 0; c < k; c++) C(c, c) += 1;
+
+		LUDecomposition capacitance(C);
+		if (capacitance.isSingular()) return false;
+
+		// Rounding errors of about eps * ||V|| * ||W|| in C are amplified by
+		// ||C^-1||, reject the update when they would spoil the new inverse
+		double scale = 1;
+		for (int c = 0; c < k; c++) {
+			double wNorm = 0, vNorm = 0;
+			for (int j = 0; j < n; j++) {
+				wNorm += W(j, c) * W(j, c);
+				vNorm += V(j, c) * V(j, c);
+			}
+			scale = std::max(scale, std::sqrt(wNorm * vNorm));
+		}
+		if (capacitance.conditionEstimate() / reductions::norm1(C) * std::numeric_limits<double>::epsilon() * scale > _tolerance) {
+			return false;
+		}
+
+		ALS_COUNT_FLOPS(6ull * n * n * k);
+
+		// A^-1 -= W * (C^-1 * Z^T)
+		Matrix S = capacitance.solve(Z.transpose());
+
+		for (int j = 0; j < n; j++) {
+			double* r = _inverse.row(j);
+			const double* w = W.row(j);
+			for (int c = 0; c < k; c++) kernels::axpy(n, -w[c], S.row(c), r);
+		}
+
+		_determinant *= capacitance.determinant();
+
+		return true;
+	}
+
+	/**
+	* A <- A + u * v^T.
+	* @param u column of n elements
+	* @param v column of n elements
+	* @return status() after the update
+	*/
+	resultStatus UpdatableInverse::rankOneUpdate(const Matrix u, const Matrix v) {
+		return rankKUpdate(u, v);
+	}
+
+	/**
+	* A <- A + U * V^T.
+	* @param U n x k
+	* @param V n x k
+	* @return status() after the update, SIZE_MISMATCH without changing A
+	* when the sizes don't match
+	*/
+	resultStatus UpdatableInverse::rankKUpdate(const Matrix U, const Matrix V) {
+
+		ALS_PROFILE_SCOPE("UpdatableInverse::update");
+
+		const int n = _A.rowCount();
+		const int k = U.colCount();
+
+		if (!_A.isSquare()) return resultStatus::NOT_SQUARE;
+		if (U.rowCount() != n || V.rowCount() != n || V.colCount() != k) return resultStatus::SIZE_MISMATCH;
+
+		for (int j = 0; j < n; j++) {
+			double* a = _A.row(j);
+			const double* u = U.row(j);
+			for (int i = 0; i < n; i++) {
+				const double* v = V.row(i);
+				for (int c = 0; c < k; c++) a[i] += u[c] * v[c];
+			}
+		}
+
+		if (_singular || !applyWoodbury(U, V)) refactor();
+		else checkAccuracy();
+
+		return status();
+	}
+
+	/**
+	* A(j, i) <- value.
+	* @return status() after the update, SIZE_MISMATCH when (j, i) is outside A
+	*/
+	resultStatus UpdatableInverse::setEntry(int j, int i, double value) {
+
+		const int n = _A.rowCount();
+
+		if (!_A.isSquare()) return resultStatus::NOT_SQUARE;
+		if (j < 0 || j >= n || i < 0 || i >= n) return resultStatus::SIZE_MISMATCH;
+
+		Matrix u(n, 1), v(n, 1);
+		for (int l = 0; l < n; l++) u(l) = v(l) = 0;
+
+		u(j) = value - _A(j, i);
+		v(i) = 1;
+
+		return rankKUpdate(u, v);
+	}
+
+	/**
+	* Replace the row j of A.
+	* @param row n elements, as a row or a column
+	* @return status() after the update, SIZE_MISMATCH for a wrong row
+	*/
+	resultStatus UpdatableInverse::setRow(int j, const Matrix row) {
+
+		const int n = _A.rowCount();
+
+		if (!_A.isSquare()) return resultStatus::NOT_SQUARE;
+		if (j < 0 || j >= n || row.rowCount() * row.colCount() != n) return resultStatus::SIZE_MISMATCH;
+
+		Matrix u(n, 1), v(n, 1);
+		for (int l = 0; l < n; l++) {
+			u(l) = 0;
+			v(l) = row(l) - _A(j, l);
+		}
+		u(j) = 1;
+
+		return rankKUpdate(u, v);
+	}
+
+	/**
+	* Replace the column i of A.
+	* @param column n elements, as a row or a column
+	* @return status() after the update, SIZE_MISMATCH for a wrong column
+	*/
+	resultStatus UpdatableInverse::setColumn(int i, const Matrix column) {
+
+		const int n = _A.rowCount();
+
+		if (!_A.isSquare()) return resultStatus::NOT_SQUARE;
+		if (i < 0 || i >= n || column.rowCount() * column.colCount() != n) return resultStatus::SIZE_MISMATCH;
+
+		Matrix u(n, 1), v(n, 1);
+		for (int l = 0; l < n; l++) {
+			u(l) = column(l) - _A(l, i);
+			v(l) = 0;
+		}
+		v(i) = 1;
+
+		return rankKUpdate(u, v);
+	}
+
+	/**
+	* Solve A * x = b with the current inverse, O(n^2) per right hand side.
+	* Meaningless unless status() is OK.
+	* @param b right hand sides (n x k)
+	*/
+	Matrix UpdatableInverse::solve(const Matrix b) const {
+		return multiply(_inverse, b);
+	}
+}
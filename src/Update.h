@@ -0,0 +1,51 @@
+#pragma once
+#include "Matrix.h"
+
+namespace als {
+
+	/**
+	* Inverse of a square matrix kept up to date through low rank changes
+	* with the Sherman-Morrison-Woodbury formula, in O(n^2) per rank-1 change
+	* instead of O(n^3) for a new inversion. The inverse is recomputed from an
+	* LU factorization when the updates lose accuracy. status() tells whether
+	* the inverse can be used, the updates return it too.
+	*/
+	class UpdatableInverse {
+
+		Matrix _A, _inverse;
+		double _determinant;
+		double _tolerance;
+		int _refactorInterval;
+		int _updates;
+		int _refactorizations;
+		bool _singular;
+
+		void refactor();
+		void checkAccuracy();
+		bool applyWoodbury(const Matrix& U, const Matrix& V);
+
+	public:
+
+		UpdatableInverse(const Matrix A, int refactorInterval = 50, double tolerance = -1);
+
+		const Matrix& matrix() const { return _A; }
+		const Matrix& inverse() const { return _inverse; }
+		double determinant() const { return _determinant; }
+		bool isSingular() const { return _singular; }
+		int refactorizations() const { return _refactorizations; }
+
+		resultStatus status() const {
+			if (!_A.isSquare()) return resultStatus::NOT_SQUARE;
+			return _singular ? resultStatus::SINGULAR : resultStatus::OK;
+		}
+
+		resultStatus setEntry(int j, int i, double value);
+		resultStatus setRow(int j, const Matrix row);
+		resultStatus setColumn(int i, const Matrix column);
+		resultStatus rankOneUpdate(const Matrix u, const Matrix v);
+		resultStatus rankKUpdate(const Matrix U, const Matrix V);
+
+		Matrix solve(const Matrix b) const;
+		double probeError(double* residual = nullptr) const;
+	};
+}
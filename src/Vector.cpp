@@ -0,0 +1,144 @@
+#include "Vector.h"
+#include "Instrumentation.h"
+#include "Kernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+/// <summary>
+/// Implementation of the vector type and of its BLAS level 1 and 2 operations.
+/// </summary>
+
+namespace als {
+
+	namespace {
+
+		[[noreturn]] void sizeMismatch(const char* operation) {
+			std::cerr << "FATAL ERROR: the sizes of the operands of " << operation << " don't match.\n";
+			std::exit(-1);
+		}
+	}
+
+	/**
+	* Copy of a single row or single column matrix.
+	*/
+	Vector Vector::fromMatrix(const Matrix& x) {
+
+		if (x.rowCount() != 1 && x.colCount() != 1) sizeMismatch("Vector::fromMatrix");
+
+		Vector v(x.rowCount() * x.colCount());
+		std::copy_n(x.data(), v.size(), v.data());
+
+		return v;
+	}
+
+	/**
+	* Copy as a column matrix (n x 1).
+	*/
+	Matrix Vector::toMatrix() const {
+
+		Matrix x(size(), 1);
+		x.fill(data());
+
+		return x;
+	}
+
+	double Vector::normInf() const {
+
+		double largest = 0;
+		for (double v : _x) {
+			if (std::isnan(v)) return v;
+			largest = std::max(largest, std::abs(v));
+		}
+
+		return largest;
+	}
+
+	double dot(const Vector& x, const Vector& y) {
+
+		if (x.size() != y.size()) sizeMismatch("dot");
+
+		ALS_COUNT_FLOPS(2ull * x.size());
+
+		return kernels::dot(x.size(), x.data(), y.data());
+	}
+
+	/**
+	* y += alpha * x
+	*/
+	void axpy(double alpha, const Vector& x, Vector& y) {
+
+		if (x.size() != y.size()) sizeMismatch("axpy");
+
+		ALS_COUNT_FLOPS(2ull * x.size());
+
+		kernels::axpy(x.size(), alpha, x.data(), y.data());
+	}
+
+	/**
+	* x *= alpha
+	*/
+	void scal(double alpha, Vector& x) {
+
+		ALS_COUNT_FLOPS(x.size());
+
+		kernels::scal(x.size(), alpha, x.data());
+	}
+
+	double nrm2(const Vector& x) {
+
+		ALS_COUNT_FLOPS(2ull * x.size());
+
+		return kernels::nrm2(x.size(), x.data());
+	}
+
+	/**
+	* A * x
+	*/
+	Vector gemv(const Matrix& A, const Vector& x) {
+
+		Vector y(A.rowCount());
+		gemv(1, A, x, 0, y);
+
+		return y;
+	}
+
+	/**
+	* y = alpha * A * x + beta * y, multithreaded for the large matrices.
+	*/
+	void gemv(double alpha, const Matrix& A, const Vector& x, double beta, Vector& y) {
+
+		ALS_PROFILE_SCOPE("gemv");
+
+		if (A.colCount() != x.size() || A.rowCount() != y.size()) sizeMismatch("gemv");
+
+		ALS_COUNT_FLOPS(2ull * A.rowCount() * A.colCount());
+
+		kernels::gemv(A.rowCount(), A.colCount(), alpha, A.data(), A.colCount(), x.data(), beta, y.data());
+	}
+
+	/**
+	* A^T * x
+	*/
+	Vector gemvTransposed(const Matrix& A, const Vector& x) {
+
+		Vector y(A.colCount());
+		gemvTransposed(1, A, x, 0, y);
+
+		return y;
+	}
+
+	/**
+	* y = alpha * A^T * x + beta * y, without forming the transpose.
+	*/
+	void gemvTransposed(double alpha, const Matrix& A, const Vector& x, double beta, Vector& y) {
+
+		ALS_PROFILE_SCOPE("gemvTransposed");
+
+		if (A.rowCount() != x.size() || A.colCount() != y.size()) sizeMismatch("gemvTransposed");
+
+		ALS_COUNT_FLOPS(2ull * A.rowCount() * A.colCount());
+
+		kernels::gemvTransposed(A.rowCount(), A.colCount(), alpha, A.data(), A.colCount(), x.data(), beta, y.data());
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "Matrix.h"
+
+#include <vector>
+
+namespace als {
+
+	/**
+	* Dense column vector owning its elements. Unlike with a Matrix(n, 1),
+	* the products with a matrix go through the matrix-vector kernels
+	* instead of the general product.
+	*/
+	class Vector {
+
+		std::vector<double> _x;
+
+	public:
+
+		explicit Vector(int n, double value = 0) : _x(n, value) {}
+		static Vector fromMatrix(const Matrix& x);
+		Matrix toMatrix() const;
+
+		int size() const { return static_cast<int>(_x.size()); }
+		double* data() { return _x.data(); }
+		const double* data() const { return _x.data(); }
+
+		double operator()(int i) const { return _x[i]; }
+		double& operator()(int i) { return _x[i]; }
+
+		double normInf() const;
+	};
+
+	double dot(const Vector& x, const Vector& y);
+	void axpy(double alpha, const Vector& x, Vector& y);
+	void scal(double alpha, Vector& x);
+	double nrm2(const Vector& x);
+
+	Vector gemv(const Matrix& A, const Vector& x);
+	void gemv(double alpha, const Matrix& A, const Vector& x, double beta, Vector& y);
+	Vector gemvTransposed(const Matrix& A, const Vector& x);
+	void gemvTransposed(double alpha, const Matrix& A, const Vector& x, double beta, Vector& y);
+}